@@ -2,7 +2,7 @@
 #define CONFIG_H
 
 /* MySensors configuration */
-#define MY_DEBUG
+// #define MY_DEBUG  // MySensors logs are blocking, only enable them to debug radio issues as they lead to tic data loss
 #define MY_RADIO_RF24
 #define MY_RF24_CE_PIN 9
 #define MY_RF24_CS_PIN 10
@@ -10,10 +10,85 @@
 #define MY_RF24_PA_LEVEL RF24_PA_LOW   // Increase transmit power if necessary, but RF24_PA_MAX can lead to frame loss because of unstable power rail
 #define MY_DEFAULT_ERR_LED_PIN A0
 #define MY_DEFAULT_TX_LED_PIN A1
+#define MY_TRANSPORT_WAIT_READY_MS 1  // Don't wait for the gateway at startup, so that tic reading starts right away
 
 /* Tic configuration */
 #define CONFIG_TIC_DATA_PIN 2
-#define CONFIG_TIC_DUMMY_PIN 5
+#define CONFIG_TIC_AUTOBAUD_SAMPLES 10       // Number of low pulses measured to detect the baud rate
+#define CONFIG_TIC_AUTOBAUD_TIMEOUT_MS 2000  // Time after which baud rate detection gives up on a silent line
+#define CONFIG_TIC_RESUME_TRIES 3            // Attempts at the last baud rate that worked before detecting it again
+#define CONFIG_TIC_RESUME_TIMEOUT_MS 3000    // Time after which an attempt gives up without a valid dataset, more than a frame
+#define CONFIG_TIC_CHECKSUM_ERRORS_MAX 10    // Datasets in a row with a wrong checksum after which the port is restarted, fewer are just skipped
+#define CONFIG_TIC_UART_BUFFER_SIZE 128      // Receive buffer size, must be a power of two, 128 gives 133 ms of margin at 9600 bps
+
+/* Transmit configuration
+ * Bursts of messages are spaced out and limited in number so that the supply from the meter has time to recover */
+#define CONFIG_TX_GAP_MS 20             // Default time between two messages of a burst, leaves the radio and the other tasks some room
+#define CONFIG_TX_BURST_GAP_MS 1000     // Minimum time between the end of a burst and the start of the next
+#define CONFIG_TX_WINDOW_S 60           // Window over which bursts are counted
+#define CONFIG_TX_WINDOW_BURSTS_MAX 20  // Bursts allowed per window, values left over are sent in a later burst
+
+/* Supply configuration
+ * The supply is measured against the internal bandgap reference, thresholds are for a 3.3 V rail, and leave room for the bandgap inaccuracy */
+#define CONFIG_SUPPLY_BANDGAP_MV 1100    // Bandgap voltage, from 1000 to 1200 mV depending on the chip, can be calibrated
+#define CONFIG_SUPPLY_MIN_MV 2800        // Under that, no message is sent
+#define CONFIG_SUPPLY_RECOVERED_MV 2900  // Under that, low priority messages (backlog and diagnostics) are deferred
+
+/* Aggregate configuration
+ * Currents, voltages and apparent powers are sent as a mean, minimum and maximum over a window, rather than as they change */
+#define CONFIG_AGGREGATE_WINDOW_S 60  // Duration of the window, 0 to send values as they change instead
+
+/* Packed configuration
+ * Values that need to be sent are packed together in as few V_CUSTOM messages as possible, free texts excepted, see the README for the format */
+#define CONFIG_PACKED_ENABLED 0     // Set to 1 to send values packed, for gateways running the decoder of the tools folder
+#define CONFIG_PACKED_RESYNC_S 300  // Time after which values are sent in full again rather than as differences, so that a decoder which missed some catches up
+
+/* Alert configuration
+ * Overloads reported by the meter, and currents close to the subscribed one, are sent right away on the alert sensor */
+#define CONFIG_ALERT_CURRENT_PERCENT 90  // Current, in percents of the subscribed one, from which an alert is raised, 0 to only rely on the meter
+#define CONFIG_ALERT_REPEAT_S 10         // Time between two alerts of a same level while it goes on
+#define CONFIG_ALERT_TRIES 3             // Attempts at sending an alert, each of them already retried by the radio
+#define CONFIG_ALERT_TIME_MAX_MS 100     // Time after which an alert isn't retried anymore, under the margin of the tic receive buffer
+
+/* Active power configuration */
+#define CONFIG_POWER_ENERGY_MIN_WH 10  // Energy the window should span, which gives a 10 % resolution
+#define CONFIG_POWER_WINDOW_MAX_S 900  // Energy increases older than that are forgotten, under 1 Wh in that time power reads 0
+
+/* Backlog configuration
+ * Samples fit in one byte as long as the energy used between two of them is under 126 Wh */
+#define CONFIG_BACKLOG_PERIOD_S 60      // Time between two samples of the energy, while the gateway can't be reached
+#define CONFIG_BACKLOG_BUFFER_SIZE 128  // Bytes of samples kept in ram
+#define CONFIG_BACKLOG_EEPROM_SIZE 128  // Bytes of samples kept in eeprom once ram is full, 0 to only use ram
+#define CONFIG_BACKLOG_BURST_SIZE 10    // Samples sent in a row once the gateway can be reached again
+
+/* Diagnostics configuration */
+#define CONFIG_DIAGNOSTICS_PERIOD_S 300  // Time between two diagnostics reports
+
+/* Scheduler configuration */
+#define CONFIG_SCHEDULER_SLEEP_ENABLED 1  // Set to 0 to keep the cpu running while no task has anything to do, rather than sleeping until the next interrupt
+
+/* Presentation configuration */
+#define CONFIG_PRESENTATION_GAP_MS 50         // Time between two presentation messages, otherwise the next fails
+#define CONFIG_PRESENTATION_RETRY_MIN_MS 100  // Time before retrying a failed presentation message, doubled on each failure
+#define CONFIG_PRESENTATION_RETRY_MAX_MS 60000
+
+/* Eeprom configuration, addresses within the area MySensors leaves to the sketch (saveState() and loadState()) */
+#define CONFIG_EEPROM_SETTINGS_ADDRESS 0
+#define CONFIG_EEPROM_BAUDRATE_ADDRESS 125  // Two bytes
+#define CONFIG_EEPROM_CONTRACT_ADDRESS 127  // One byte, just before the backlog
+#define CONFIG_EEPROM_BACKLOG_ADDRESS 128   // Followed by CONFIG_BACKLOG_EEPROM_SIZE bytes, up to 255
+
+/* Log configuration
+ * Each module has its own log level, messages above it are not compiled in */
+#define CONFIG_LOG_BUFFER_SIZE 128     // Logs waiting to be output, must be a power of two
+#define CONFIG_LOG_LINE_LENGTH_MAX 64  // Longer log messages are truncated
+#define CONFIG_LOG_LEVEL_MAIN LOG_LEVEL_INFO
+#define CONFIG_LOG_LEVEL_TIC LOG_LEVEL_INFO  // Set to LOG_LEVEL_DEBUG to log every dataset received
+
+/* Profile configuration
+ * When enabled, loop, dispatch and send times are measured, and can be output by sending 'p' on the serial port */
+#define CONFIG_PROFILE_ENABLED 0
+#define CONFIG_PROFILE_LOOP_SAMPLING 32  // One loop in that many is timed, must be a power of two
 
 /* Leds configuration */
 #define CONFIG_LED_TIC_GREEN_PIN 4
@@ -0,0 +1,102 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+/* Minimal Arduino core for the native build, just enough for the firmware to run on a computer
+ * Time is virtual, and advanced by the benchmark rather than by the wall clock */
+
+/* C/C++ libraries */
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Flash memory is regular memory */
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) ((const __FlashStringHelper *)(s))
+class __FlashStringHelper;
+typedef const char *PGM_P;
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p) (*(void *const *)(p))
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+/* Pins */
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts(void);
+void interrupts(void);
+
+/* Time */
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+
+/* Streams */
+class Print {
+   public:
+    virtual size_t write(uint8_t data) = 0;
+    virtual int availableForWrite(void) {
+        return 0;
+    }
+    size_t write(const char *str) {
+        size_t length = 0;
+        while (*str != '\0') {
+            length += write((uint8_t)*str++);
+        }
+        return length;
+    }
+    size_t print(const char *str) {
+        return write(str);
+    }
+    size_t print(const __FlashStringHelper *str) {
+        return write((const char *)str);
+    }
+    size_t println(const char *str) {
+        return write(str) + write("\r\n");
+    }
+    size_t println(const __FlashStringHelper *str) {
+        return write((const char *)str) + write("\r\n");
+    }
+};
+class Stream : public Print {
+   public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+};
+class HardwareSerial : public Stream {
+   public:
+    void begin(unsigned long baudrate);
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t data);
+    using Print::write;
+    int availableForWrite(void);
+};
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef MYSENSORS_H
+#define MYSENSORS_H
+
+/* Minimal MySensors api for the native build, messages are counted by the benchmark rather than sent */
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/* Sensor types, variable types and commands, with the values of MySensors */
+enum {
+    S_POWER = 13,
+    S_CUSTOM = 23,
+    S_MULTIMETER = 30,
+    S_INFO = 36,
+};
+enum {
+    V_WATT = 17,
+    V_KWH = 18,
+    V_VAR1 = 24,
+    V_VAR2 = 25,
+    V_VAR3 = 26,
+    V_VAR4 = 27,
+    V_VAR5 = 28,
+    V_VOLTAGE = 38,
+    V_CURRENT = 39,
+    V_TEXT = 47,
+    V_CUSTOM = 48,
+};
+enum {
+    C_PRESENTATION = 0,
+    C_SET = 1,
+    C_REQ = 2,
+    C_INTERNAL = 3,
+};
+#define MAX_PAYLOAD_SIZE 25
+
+/* Messages only keep what the firmware reads back */
+class MyMessage {
+   public:
+    MyMessage(void) : m_sensor(0), m_type(0), m_length(0), m_binary(false) {
+        m_payload[0] = '\0';
+    }
+    MyMessage(const uint8_t sensor, const uint8_t type) : m_sensor(sensor), m_type(type), m_length(0), m_binary(false) {
+        m_payload[0] = '\0';
+    }
+    MyMessage &set(const char *value) {
+        m_length = snprintf(m_payload, sizeof(m_payload), "%s", value);
+        m_binary = false;
+        return *this;
+    }
+    MyMessage &set(const void *value, const size_t length) {
+        m_length = (length < MAX_PAYLOAD_SIZE) ? length : MAX_PAYLOAD_SIZE;
+        memcpy(m_payload, value, m_length);
+        m_payload[m_length] = '\0';
+        m_binary = true;
+        return *this;
+    }
+    MyMessage &set(const uint8_t value) {
+        return set((uint32_t)value);
+    }
+    MyMessage &set(const uint16_t value) {
+        return set((uint32_t)value);
+    }
+    MyMessage &set(const uint32_t value) {
+        m_length = snprintf(m_payload, sizeof(m_payload), "%lu", (unsigned long)value);
+        m_binary = false;
+        return *this;
+    }
+    uint8_t getCommand(void) const {
+        return C_SET;
+    }
+    uint8_t getSensor(void) const {
+        return m_sensor;
+    }
+    uint8_t getType(void) const {
+        return m_type;
+    }
+    bool isEcho(void) const {
+        return false;
+    }
+    char *getString(char *buffer) const {
+        if (m_binary == true) {
+            for (uint8_t i = 0; i < m_length; i++) {
+                sprintf(&buffer[i * 2], "%02X", (uint8_t)m_payload[i]);
+            }
+            return buffer;
+        }
+        return strcpy(buffer, m_payload);
+    }
+
+   protected:
+    uint8_t m_sensor;
+    uint8_t m_type;
+    char m_payload[MAX_PAYLOAD_SIZE + 1];
+    uint8_t m_length;
+    bool m_binary;  // Binary payloads are given as hexadecimal by getString(), as MySensors does
+};
+
+bool send(MyMessage &message, const bool echo = false);
+bool present(const uint8_t sensor, const uint8_t type, const __FlashStringHelper *description, const bool echo = false);
+bool sendSketchInfo(const __FlashStringHelper *name, const __FlashStringHelper *version, const bool echo = false);
+void saveState(const uint8_t position, const uint8_t value);
+uint8_t loadState(const uint8_t position);
+
+#endif
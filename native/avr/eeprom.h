@@ -0,0 +1,10 @@
+#ifndef AVR_EEPROM_H
+#define AVR_EEPROM_H
+
+/* C/C++ libraries */
+#include <stdint.h>
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
+
+#endif
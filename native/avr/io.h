@@ -0,0 +1,4 @@
+#ifndef AVR_IO_H
+#define AVR_IO_H
+/* Nothing to see here, hardware specific files aren't part of the native build */
+#endif
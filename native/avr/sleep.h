@@ -0,0 +1,14 @@
+#ifndef AVR_SLEEP_H
+#define AVR_SLEEP_H
+
+/* C/C++ libraries */
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+
+void set_sleep_mode(uint8_t mode);
+void sleep_enable(void);
+void sleep_cpu(void);
+void sleep_disable(void);
+
+#endif
@@ -0,0 +1,263 @@
+/* Firmware, built as is on top of the native hardware */
+#include "../src/main.cpp"
+
+/* Native hardware and meter emulator */
+#include "hardware.h"
+#include "tic_emulator.h"
+
+/* C/C++ libraries */
+#include <time.h>
+#include <unistd.h>
+
+/* Time a loop iteration takes on the board, when it has something to do, in us */
+#define BENCHMARK_LOOP_US 50
+
+/* Longest time the firmware is left idle, so that its timers run, in us */
+#define BENCHMARK_IDLE_MAX_US 1000
+
+/* Time it takes to send a message, in us */
+#define BENCHMARK_SEND_US 3000
+
+/* Working variables */
+static tic_emulator m_emulator;
+static uint32_t m_values_offered = 0;  // Datasets sent intact by the meter, with a label the firmware is interested in
+
+/**
+ * @return The next character from the meter.
+ */
+static uint8_t benchmark_tic_source(void) {
+    return m_emulator.read();
+}
+
+/**
+ * Counts the datasets the firmware should receive and be interested in.
+ * @param[in] name The label of the dataset.
+ * @param[in] corrupted Whether the dataset has been corrupted.
+ */
+static void benchmark_dataset_count(const char *name, const bool corrupted) {
+    for (uint8_t i = 0; corrupted == false && i < LABEL_COUNT; i++) {
+        if (strcmp(name, m_labels[i].name) == 0) {
+            m_values_offered++;
+            break;
+        }
+    }
+}
+
+/**
+ * Accumulates a counter of the firmware that is reset once reported.
+ * @param[in] counter The counter.
+ * @param[in,out] last The value of the counter when last accumulated.
+ * @param[in,out] total The total.
+ */
+static void benchmark_counter_accumulate(uint16_t counter, uint16_t &last, uint32_t &total) {
+    total += (counter >= last) ? (counter - last) : counter;
+    last = counter;
+}
+
+/**
+ * Compares format_uint() and format_milli() with snprintf() over the whole range of 32 bits integers, text and length.
+ * @param[in] output Where to print mismatches.
+ * @return The number of integers for which either function differs.
+ */
+static uint32_t benchmark_format_check(FILE *output) {
+    uint32_t mismatches = 0;
+    uint32_t value = 0;
+    do {
+        char expected[FORMAT_MILLI_LENGTH_MAX + 1];
+        char actual[FORMAT_MILLI_LENGTH_MAX + 1];
+        int expected_length = snprintf(expected, sizeof(expected), "%lu", (unsigned long)value);
+        bool match = (format_uint(actual, value) == expected_length && strcmp(actual, expected) == 0);
+        expected_length = snprintf(expected, sizeof(expected), "%lu.%03lu", (unsigned long)(value / 1000), (unsigned long)(value % 1000));
+        match = match && (format_milli(actual, value) == expected_length && strcmp(actual, expected) == 0);
+        if (match == false) {
+            if (mismatches < 10) {
+                fprintf(output, "Mismatch for %lu\n", (unsigned long)value);
+            }
+            mismatches++;
+        }
+        value++;
+    } while (value != 0);
+    return mismatches;
+}
+
+/**
+ * Prints how to use the benchmark.
+ * @param[in] name The name of the program.
+ */
+static void benchmark_usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-c contract] [-n frames] [-e ppm] [-b ppm] [-l ppm] [-o current] [-s seed] [-g] [-v] [-f]\n"
+            "  -c  base, hc, ejp, tempo, base3 (historic, 1200 Bd), standard, standard3 (standard, 9600 Bd), defaults to base\n"
+            "  -n  number of frames to send, defaults to 1000\n"
+            "  -e  probability of a dataset having a wrong checksum, in parts per million\n"
+            "  -b  probability of a character having a bit flipped by line noise, in parts per million\n"
+            "  -l  probability of a message not being acknowledged, in parts per million\n"
+            "  -o  subscribed current per phase in A, historic mode only, under 39 A (13 A for base3) to have overloads\n"
+            "  -s  seed, to reproduce a run\n"
+            "  -g  print messages on the standard output as a serial gateway would, and statistics on the standard error output\n"
+            "  -v  print the log of the firmware on the standard error output\n"
+            "  -f  only check number formatting against snprintf(), over every 32 bits integer, which takes about half an hour\n",
+            name);
+}
+
+/**
+ * Runs the firmware against the meter emulator, then prints statistics about the pipeline.
+ */
+int main(int argc, char **argv) {
+
+    /* Parse options */
+    static const char *const contracts[TIC_EMULATOR_CONTRACT_COUNT] = {"base", "hc", "ejp", "tempo", "base3", "standard", "standard3"};
+    uint8_t contract = TIC_EMULATOR_CONTRACT_BASE;
+    uint32_t frames = 1000;
+    uint32_t checksum_ppm = 0;
+    uint32_t noise_ppm = 0;
+    uint32_t loss_ppm = 0;
+    uint8_t subscribed_a = 0;
+    uint32_t seed = 1;
+    FILE *output = stdout;
+    int option;
+    while ((option = getopt(argc, argv, "c:n:e:b:l:o:s:gvf")) != -1) {
+        switch (option) {
+            case 'c': {
+                for (contract = 0; contract < TIC_EMULATOR_CONTRACT_COUNT; contract++) {
+                    if (strcmp(optarg, contracts[contract]) == 0) {
+                        break;
+                    }
+                }
+                if (contract == TIC_EMULATOR_CONTRACT_COUNT) {
+                    benchmark_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
+            case 'n': {
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 'e': {
+                checksum_ppm = strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 'b': {
+                noise_ppm = strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 'l': {
+                loss_ppm = strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 'o': {
+                subscribed_a = strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 's': {
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            }
+            case 'g': {
+                hardware_radio_print_set(true);
+                output = stderr;
+                break;
+            }
+            case 'v': {
+                hardware_serial_echo_set(true);
+                break;
+            }
+            case 'f': {
+                uint32_t mismatches = benchmark_format_check(output);
+                fprintf(output, "Formatting            %lu mismatches\n", (unsigned long)mismatches);
+                return (mismatches == 0) ? 0 : 1;
+            }
+            default: {
+                benchmark_usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    /* Setup meter and radio */
+    m_emulator.setup((enum tic_emulator_contract)contract, seed);
+    m_emulator.errors_set(checksum_ppm, noise_ppm);
+    if (subscribed_a != 0) {
+        m_emulator.subscribed_set(subscribed_a);
+    }
+    m_emulator.dataset_callback_set(benchmark_dataset_count);
+    hardware_radio_setup(BENCHMARK_SEND_US, loss_ppm, seed);
+
+    /* Start firmware as MySensors would */
+    preHwInit();
+    setup();
+    presentation();
+    hardware_tic_line_set(m_emulator.baudrate(), benchmark_tic_source);
+
+    /* Run until enough frames have been sent
+     * Time runs faster than on the board while the firmware is idle, as it then skips ahead to the next character.
+     * The latency of alerts runs from the end of the first overload warning on the line to the next alert sent.
+     * When the firmware goes to sleep, it is considered asleep for the time skipped, until the next character or millis() tick */
+    uint16_t frames_last = 0, datasets_last = 0;
+    uint32_t frames_total = 0, datasets_total = 0;
+    uint32_t overloads_last = 0, alerts_last = 0, alerts_timed = 0;
+    uint64_t overload_us = 0, alerts_latency_us = 0, alerts_latency_max_us = 0;
+    bool overload_pending = false;
+    uint32_t sleeps_last = 0;
+    uint64_t asleep_us = 0;
+    clock_t cpu_start = clock();
+    while (m_emulator.frames() <= frames) {
+        loop();
+        if (hardware_radio_sent(SENSOR_46_ALERT) != alerts_last) {
+            alerts_last = hardware_radio_sent(SENSOR_46_ALERT);
+            if (overload_pending == true) {
+                uint64_t latency_us = hardware_time_us() - overload_us;
+                alerts_latency_us += latency_us;
+                alerts_latency_max_us = (latency_us > alerts_latency_max_us) ? latency_us : alerts_latency_max_us;
+                alerts_timed++;
+                overload_pending = false;
+            }
+        }
+        if (m_tic_port.available() > 0) {
+            hardware_time_advance(BENCHMARK_LOOP_US);
+        } else {
+            uint32_t idle_us = hardware_time_next_character_us();
+            idle_us = (idle_us < BENCHMARK_IDLE_MAX_US) ? ((idle_us > BENCHMARK_LOOP_US) ? idle_us : BENCHMARK_LOOP_US) : BENCHMARK_IDLE_MAX_US;
+            hardware_time_advance(idle_us);
+            if (hardware_sleeps() != sleeps_last) {
+                asleep_us += idle_us - BENCHMARK_LOOP_US;
+            }
+        }
+        sleeps_last = hardware_sleeps();
+        if (m_emulator.overloads() != overloads_last) {
+            overloads_last = m_emulator.overloads();
+            overload_us = hardware_time_us();
+            overload_pending = true;
+        }
+        benchmark_counter_accumulate(m_diagnostics.frames, frames_last, frames_total);
+        benchmark_counter_accumulate(m_diagnostics.datasets, datasets_last, datasets_total);
+    }
+    double cpu_s = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    /* Sum messages */
+    uint32_t messages_values = 0, messages_other = 0, messages_lost = 0;
+    for (uint8_t sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+        if (sensor == SENSOR_41_CONFIGURATION || sensor == SENSOR_42_DIAGNOSTICS || sensor == SENSOR_44_HISTORY || sensor == SENSOR_46_ALERT) {
+            messages_other += hardware_radio_sent(sensor);
+        } else {
+            messages_values += hardware_radio_sent(sensor);
+        }
+        messages_lost += hardware_radio_lost(sensor);
+    }
+
+    /* Print statistics */
+    double time_s = (double)hardware_time_us() / 1000000;
+    fprintf(output, "Contract              %s, %u Bd\n", contracts[contract], m_emulator.baudrate());
+    fprintf(output, "Meter time            %.0f s\n", time_s);
+    fprintf(output, "Frames                %lu sent, %lu received\n", (unsigned long)m_emulator.frames() - 1, (unsigned long)frames_total);
+    fprintf(output, "Datasets              %lu sent, %lu corrupted, %lu received\n", (unsigned long)m_emulator.datasets(), (unsigned long)m_emulator.datasets_corrupted(), (unsigned long)datasets_total);
+    fprintf(output, "Errors                %u checksum, %u malformed, %u parity, %u overflows, %u detections\n", m_diagnostics.tic_checksum_errors, m_diagnostics.tic_errors, m_tic_port.errors_parity(), m_tic_port.errors_overflow(), m_diagnostics.detections);
+    fprintf(output, "Throughput            %.0f datasets/s of host cpu\n", (cpu_s > 0) ? (datasets_total / cpu_s) : 0);
+    fprintf(output, "Messages              %lu values, %lu others, %lu lost, %lu presentation\n", (unsigned long)messages_values, (unsigned long)messages_other, (unsigned long)messages_lost, (unsigned long)hardware_radio_presented());
+    fprintf(output, "Messages per frame    %.3f\n", (frames_total > 0) ? ((double)messages_values / frames_total) : 0);
+    fprintf(output, "Dedup hit rate        %.1f %%\n", (m_values_offered > 0) ? (100 * (1 - (double)messages_values / m_values_offered)) : 0);
+    fprintf(output, "Cpu asleep            %.1f %% of the time\n", 100 * (double)asleep_us / hardware_time_us());
+    fprintf(output, "Overloads             %lu, %lu alerts sent, %.1f ms mean latency, %.1f ms max\n", (unsigned long)m_emulator.overloads(), (unsigned long)alerts_last, (alerts_timed > 0) ? ((double)alerts_latency_us / alerts_timed / 1000) : 0, (double)alerts_latency_max_us / 1000);
+    return 0;
+}
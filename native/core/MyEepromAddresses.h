@@ -0,0 +1,7 @@
+#ifndef MYEEPROMADDRESSES_H
+#define MYEEPROMADDRESSES_H
+
+/* First address MySensors leaves to the sketch, its value doesn't matter on a computer */
+#define EEPROM_LOCAL_CONFIG_ADDRESS 413
+
+#endif
@@ -0,0 +1,417 @@
+/* Self header */
+#include "hardware.h"
+
+/* Config */
+#include "../cfg/config.h"
+
+/* Arduino Libraries */
+#include <Arduino.h>
+#include <MySensors.h>
+
+/* AVR libraries */
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <core/MyEepromAddresses.h>
+
+/* Firmware modules replaced by this file */
+#include "../src/memory.h"
+#include "../src/supply_monitor.h"
+#include "../src/tic_autobaud.h"
+#include "../src/tic_uart.h"
+
+/* C/C++ libraries */
+#include <errno.h>
+
+/* Number of bits in a character: start, 7 data, parity and stop */
+#define HARDWARE_TIC_FRAME_BITS 10
+
+/* Working variables */
+static uint64_t m_time_us = 0;
+static uint16_t m_tic_baudrate = 0;
+static uint8_t (*m_tic_source)(void) = NULL;
+static uint64_t m_tic_next_us = 0;
+static uint8_t m_tic_character;
+static uint32_t m_radio_send_us = 0;
+static uint32_t m_radio_loss_ppm = 0;
+static uint32_t m_radio_random = 1;
+static uint32_t m_radio_sent[256];
+static uint32_t m_radio_lost[256];
+static uint32_t m_radio_presented = 0;
+static bool m_radio_print = false;
+static bool m_serial_echo = false;
+static uint8_t m_eeprom[1024];
+static bool m_eeprom_initialized = false;
+static uint32_t m_sleeps = 0;
+HardwareSerial Serial;
+
+/* Interrupt handler of the tic port, called at the end of each character of the tic line */
+void tic_uart_isr_compare(void);
+
+/**
+ * Advances time, delivering the characters of the tic line that end in the meantime.
+ * @param[in] us The time to advance by, in us.
+ */
+void hardware_time_advance(const uint32_t us) {
+    uint64_t end_us = m_time_us + us;
+    while (m_tic_source != NULL && m_tic_next_us <= end_us) {
+        m_time_us = m_tic_next_us;
+        m_tic_character = m_tic_source();
+        tic_uart_isr_compare();
+        m_tic_next_us += (1000000UL * HARDWARE_TIC_FRAME_BITS) / m_tic_baudrate;
+    }
+    m_time_us = end_us;
+}
+
+/**
+ * @return The time since startup, in us.
+ */
+uint64_t hardware_time_us(void) {
+    return m_time_us;
+}
+
+/**
+ * @return The time until the next character of the tic line ends, in us, or UINT32_MAX if the line is idle.
+ */
+uint32_t hardware_time_next_character_us(void) {
+    if (m_tic_source == NULL) {
+        return UINT32_MAX;
+    }
+    return m_tic_next_us - m_time_us;
+}
+
+/**
+ * Connects the tic line to a source of characters, which starts sending right away.
+ * @param[in] baudrate The baud rate of the line.
+ * @param[in] source The function returning the next character on the wire: 7 bits, with the even parity bit as most significant bit.
+ */
+void hardware_tic_line_set(uint16_t baudrate, uint8_t (*source)(void)) {
+    m_tic_baudrate = baudrate;
+    m_tic_source = source;
+    m_tic_next_us = m_time_us + (1000000UL * HARDWARE_TIC_FRAME_BITS) / baudrate;
+}
+
+/**
+ * Configures the radio.
+ * @param[in] send_us The time it takes to send a message, during which the firmware is blocked.
+ * @param[in] loss_ppm The probability of a message not being acknowledged, in parts per million.
+ * @param[in] seed The seed of the losses, so that they can be reproduced.
+ */
+void hardware_radio_setup(const uint32_t send_us, const uint32_t loss_ppm, const uint32_t seed) {
+    m_radio_send_us = send_us;
+    m_radio_loss_ppm = loss_ppm;
+    m_radio_random = (seed == 0) ? 1 : seed;
+}
+
+/**
+ * @param[in] sensor The sensor.
+ * @return The number of messages of that sensor acknowledged so far.
+ */
+uint32_t hardware_radio_sent(const uint8_t sensor) {
+    return m_radio_sent[sensor];
+}
+
+/**
+ * @param[in] sensor The sensor.
+ * @return The number of messages of that sensor lost so far.
+ */
+uint32_t hardware_radio_lost(const uint8_t sensor) {
+    return m_radio_lost[sensor];
+}
+
+/**
+ * @return The number of presentation messages sent so far, sketch information included.
+ */
+uint32_t hardware_radio_presented(void) {
+    return m_radio_presented;
+}
+
+/**
+ * @param[in] print Whether messages acknowledged are printed on the standard output, as a serial gateway would.
+ */
+void hardware_radio_print_set(const bool print) {
+    m_radio_print = print;
+}
+
+/**
+ * @param[in] echo Whether what the firmware writes on the serial port is printed on the standard error output.
+ */
+void hardware_serial_echo_set(const bool echo) {
+    m_serial_echo = echo;
+}
+
+/* Arduino core */
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+void digitalWrite(uint8_t pin, uint8_t value) {
+    (void)pin;
+    (void)value;
+}
+int digitalRead(uint8_t pin) {
+    (void)pin;
+    return HIGH;
+}
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode) {
+    (void)interrupt;
+    (void)isr;
+    (void)mode;
+}
+void detachInterrupt(uint8_t interrupt) {
+    (void)interrupt;
+}
+void noInterrupts(void) {
+}
+void interrupts(void) {
+}
+uint32_t millis(void) {
+    return m_time_us / 1000;
+}
+uint32_t micros(void) {
+    return m_time_us;
+}
+void delay(uint32_t ms) {
+    hardware_time_advance(ms * 1000);
+}
+void HardwareSerial::begin(unsigned long baudrate) {
+    (void)baudrate;
+}
+int HardwareSerial::available(void) {
+    return 0;
+}
+int HardwareSerial::read(void) {
+    return -1;
+}
+int HardwareSerial::peek(void) {
+    return -1;
+}
+size_t HardwareSerial::write(uint8_t data) {
+    if (m_serial_echo == true) {
+        fputc(data, stderr);
+    }
+    return 1;
+}
+int HardwareSerial::availableForWrite(void) {
+    return 64;
+}
+
+/* Cpu, which doesn't actually sleep, as time only advances when told to */
+void set_sleep_mode(uint8_t mode) {
+    (void)mode;
+}
+void sleep_enable(void) {
+}
+void sleep_cpu(void) {
+    m_sleeps++;
+}
+void sleep_disable(void) {
+}
+uint32_t hardware_sleeps(void) {
+    return m_sleeps;
+}
+
+/* Eeprom, erased at startup */
+static uint8_t *eeprom_cell(const uint8_t *address) {
+    if (m_eeprom_initialized == false) {
+        memset(m_eeprom, 0xFF, sizeof(m_eeprom));
+        m_eeprom_initialized = true;
+    }
+    return &m_eeprom[(uintptr_t)address % sizeof(m_eeprom)];
+}
+uint8_t eeprom_read_byte(const uint8_t *address) {
+    return *eeprom_cell(address);
+}
+void eeprom_update_byte(uint8_t *address, uint8_t value) {
+    *eeprom_cell(address) = value;
+}
+
+/* MySensors */
+bool send(MyMessage &message, const bool echo) {
+    (void)echo;
+    hardware_time_advance(m_radio_send_us);
+    m_radio_random ^= m_radio_random << 13;
+    m_radio_random ^= m_radio_random >> 17;
+    m_radio_random ^= m_radio_random << 5;
+    if (m_radio_random % 1000000 < m_radio_loss_ppm) {
+        m_radio_lost[message.getSensor()]++;
+        return false;
+    }
+    m_radio_sent[message.getSensor()]++;
+    if (m_radio_print == true) {
+        char payload[MAX_PAYLOAD_SIZE * 2 + 1];
+        printf("1;%u;%u;0;%u;%s\n", message.getSensor(), message.getCommand(), message.getType(), message.getString(payload));
+    }
+    return true;
+}
+bool present(const uint8_t sensor, const uint8_t type, const __FlashStringHelper *description, const bool echo) {
+    (void)sensor;
+    (void)type;
+    (void)description;
+    (void)echo;
+    hardware_time_advance(m_radio_send_us);
+    m_radio_presented++;
+    return true;
+}
+bool sendSketchInfo(const __FlashStringHelper *name, const __FlashStringHelper *version, const bool echo) {
+    (void)name;
+    (void)version;
+    (void)echo;
+    hardware_time_advance(m_radio_send_us);
+    m_radio_presented++;
+    return true;
+}
+void saveState(const uint8_t position, const uint8_t value) {
+    eeprom_update_byte((uint8_t *)(uintptr_t)(EEPROM_LOCAL_CONFIG_ADDRESS + position), value);
+}
+uint8_t loadState(const uint8_t position) {
+    return eeprom_read_byte((const uint8_t *)(uintptr_t)(EEPROM_LOCAL_CONFIG_ADDRESS + position));
+}
+
+/* Tic port, receiving the characters of the tic line once started, with the same checks and buffering as on the board */
+uint8_t tic_uart::m_pin = 0xFF;
+uint16_t tic_uart::m_bit_ticks = 0;
+volatile uint16_t tic_uart::m_bits;
+volatile uint8_t tic_uart::m_buffer[CONFIG_TIC_UART_BUFFER_SIZE];
+volatile uint8_t tic_uart::m_buffer_head = 0;
+volatile uint8_t tic_uart::m_buffer_tail = 0;
+volatile uint16_t tic_uart::m_errors_framing = 0;
+volatile uint16_t tic_uart::m_errors_parity = 0;
+volatile uint16_t tic_uart::m_errors_overflow = 0;
+int tic_uart::setup(const uint8_t pin) {
+    m_pin = pin;
+    return 0;
+}
+int tic_uart::begin(const uint16_t baudrate) {
+    if (m_pin == 0xFF || baudrate == 0) {
+        return -EINVAL;
+    }
+    m_bit_ticks = baudrate;
+    m_buffer_head = 0;
+    m_buffer_tail = 0;
+    return 0;
+}
+void tic_uart::end(void) {
+    m_bit_ticks = 0;
+}
+int tic_uart::available(void) {
+    return (uint8_t)(m_buffer_head - m_buffer_tail) & (CONFIG_TIC_UART_BUFFER_SIZE - 1);
+}
+int tic_uart::read(void) {
+    if (m_buffer_head == m_buffer_tail) {
+        return -1;
+    }
+    uint8_t data = m_buffer[m_buffer_tail];
+    m_buffer_tail = (m_buffer_tail + 1) & (CONFIG_TIC_UART_BUFFER_SIZE - 1);
+    return data;
+}
+int tic_uart::peek(void) {
+    if (m_buffer_head == m_buffer_tail) {
+        return -1;
+    }
+    return m_buffer[m_buffer_tail];
+}
+size_t tic_uart::write(uint8_t data) {
+    (void)data;
+    return 0;
+}
+uint16_t tic_uart::errors_framing(void) {
+    return m_errors_framing;
+}
+uint16_t tic_uart::errors_parity(void) {
+    return m_errors_parity;
+}
+uint16_t tic_uart::errors_overflow(void) {
+    return m_errors_overflow;
+}
+void tic_uart::frame_end(void) {
+
+    /* Ensure stop bit is high */
+    if ((m_bits & (1 << (HARDWARE_TIC_FRAME_BITS - 1))) == 0) {
+        m_errors_framing++;
+        return;
+    }
+
+    /* Ensure parity is even, over data and parity bits */
+    uint8_t data = (m_bits >> 1) & 0x7F;
+    uint8_t parity = (m_bits >> 8) & 1;
+    for (uint8_t i = data; i != 0; i >>= 1) {
+        parity ^= i & 1;
+    }
+    if (parity != 0) {
+        m_errors_parity++;
+        return;
+    }
+
+    /* Push into buffer */
+    uint8_t head_next = (m_buffer_head + 1) & (CONFIG_TIC_UART_BUFFER_SIZE - 1);
+    if (head_next == m_buffer_tail) {
+        m_errors_overflow++;
+        return;
+    }
+    m_buffer[m_buffer_head] = data;
+    m_buffer_head = head_next;
+}
+void tic_uart_isr_compare(void) {
+
+    /* A port started at another baud rate than the one of the line only samples garbage, which mostly shows as framing errors */
+    if (tic_uart::m_bit_ticks != 0 && tic_uart::m_bit_ticks != m_tic_baudrate) {
+        tic_uart::m_errors_framing++;
+    } else if (tic_uart::m_bit_ticks != 0) {
+        tic_uart::m_bits = ((uint16_t)m_tic_character << 1) | (1 << (HARDWARE_TIC_FRAME_BITS - 1));
+        tic_uart::frame_end();
+    }
+}
+
+/* Baud rate detection, which finds the baud rate of the tic line right away */
+uint8_t tic_autobaud::m_pin = 0xFF;
+int tic_autobaud::setup(const uint8_t pin) {
+    m_pin = pin;
+    m_running = false;
+    return 0;
+}
+int tic_autobaud::start(void) {
+    m_running = true;
+    m_start_ms = millis();
+    return 0;
+}
+int tic_autobaud::poll(uint16_t &baudrate) {
+    if (m_running == false) {
+        return -EINVAL;
+    }
+    if (m_tic_source == NULL) {
+        if (millis() - m_start_ms >= CONFIG_TIC_AUTOBAUD_TIMEOUT_MS) {
+            m_running = false;
+            return -ETIMEDOUT;
+        }
+        return 0;
+    }
+    m_running = false;
+    baudrate = m_tic_baudrate;
+    return 1;
+}
+void tic_autobaud::stop(void) {
+    m_running = false;
+}
+
+/* Supply monitoring, which always measures a healthy supply */
+int supply_monitor::setup(void) {
+    m_state = STATE_CONVERTING;
+    m_millivolts = 3300;
+    return 0;
+}
+void supply_monitor::poll(void) {
+}
+uint16_t supply_monitor::millivolts(void) {
+    return m_millivolts;
+}
+
+/* Memory usage, which isn't meaningful on a computer */
+uint16_t memory_static(void) {
+    return 0;
+}
+uint16_t memory_free(void) {
+    return 0;
+}
+uint16_t memory_stack_unused(void) {
+    return 0;
+}
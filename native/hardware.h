@@ -0,0 +1,29 @@
+#ifndef HARDWARE_H
+#define HARDWARE_H
+
+/* C/C++ libraries */
+#include <stdint.h>
+
+/* Time, which only advances when told to
+ * Characters of the tic line due in the meantime are delivered to the tic port as they would by its interrupt */
+void hardware_time_advance(const uint32_t us);
+uint64_t hardware_time_us(void);
+uint32_t hardware_time_next_character_us(void);
+
+/* Tic line, driven by a source of characters as they are on the wire: 7 bits, with the even parity bit as most significant bit */
+void hardware_tic_line_set(uint16_t baudrate, uint8_t (*source)(void));
+
+/* Radio, where each message takes some time to send, and some can be lost */
+void hardware_radio_setup(const uint32_t send_us, const uint32_t loss_ppm, const uint32_t seed);
+uint32_t hardware_radio_sent(const uint8_t sensor);
+uint32_t hardware_radio_lost(const uint8_t sensor);
+uint32_t hardware_radio_presented(void);
+void hardware_radio_print_set(const bool print);
+
+/* Cpu, whose sleeps are counted */
+uint32_t hardware_sleeps(void);
+
+/* Serial port to computer, whose output is either printed or discarded */
+void hardware_serial_echo_set(const bool echo);
+
+#endif
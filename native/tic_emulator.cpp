@@ -0,0 +1,447 @@
+/* Self header */
+#include "tic_emulator.h"
+
+/* C/C++ libraries */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Control characters of the tic link */
+#define TIC_STX 0x02
+#define TIC_ETX 0x03
+#define TIC_LF 0x0A
+#define TIC_CR 0x0D
+#define TIC_SP 0x20
+#define TIC_HT 0x09
+
+/* Consumption model: apparent power wanders between these bounds, and the power factor is taken as 1 */
+#define TIC_EMULATOR_POWER_MIN_VA 80
+#define TIC_EMULATOR_POWER_MAX_VA 9000
+#define TIC_EMULATOR_VOLTAGE_V 230
+
+/* Tariff periods switch every so often, whatever the time of day, so that all indexes move in a short run */
+#define TIC_EMULATOR_PERIOD_S 600
+
+/**
+ * Starts emulating a meter.
+ * @param[in] contract The contract of the meter, which also gives its mode.
+ * @param[in] seed The seed of the consumption and of the errors, so that a run can be reproduced.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int tic_emulator::setup(const enum tic_emulator_contract contract, const uint32_t seed) {
+    if (contract >= TIC_EMULATOR_CONTRACT_COUNT) {
+        return -EINVAL;
+    }
+    m_contract = contract;
+    m_standard = (contract == TIC_EMULATOR_CONTRACT_STANDARD || contract == TIC_EMULATOR_CONTRACT_STANDARD_TRIPHASE);
+    m_random = (seed == 0) ? 1 : seed;
+    m_checksum_ppm = 0;
+    m_noise_ppm = 0;
+    m_subscribed_a = (contract == TIC_EMULATOR_CONTRACT_BASE_TRIPHASE) ? 20 : 45;
+    m_dataset_callback = NULL;
+    m_frame_length = 0;
+    m_frame_position = 0;
+    m_overload_position = 0;
+    m_overload = false;
+    m_time_s = 0;
+    m_power_va = 500;
+    for (uint8_t i = 0; i < 6; i++) {
+        m_energy_mwh[i] = (uint64_t)(1000000 + random() % 20000000) * 1000;
+    }
+    m_frames = 0;
+    m_datasets = 0;
+    m_datasets_corrupted = 0;
+    m_characters_corrupted = 0;
+    m_overloads = 0;
+    return 0;
+}
+
+/**
+ * Configures the errors injected in the frames.
+ * @param[in] checksum_ppm The probability of a dataset having a wrong checksum, in parts per million.
+ * @param[in] noise_ppm The probability of a character having a bit flipped, in parts per million.
+ */
+void tic_emulator::errors_set(const uint32_t checksum_ppm, const uint32_t noise_ppm) {
+    m_checksum_ppm = checksum_ppm;
+    m_noise_ppm = noise_ppm;
+}
+
+/**
+ * Sets the subscribed current, per phase, lower than the default to have overloads.
+ * @param[in] current_a The current, in A.
+ */
+void tic_emulator::subscribed_set(const uint8_t current_a) {
+    m_subscribed_a = current_a;
+}
+
+/**
+ * @return The baud rate of the meter: 1200 in historic mode, 9600 in standard mode.
+ */
+uint16_t tic_emulator::baudrate(void) {
+    return m_standard ? 9600 : 1200;
+}
+
+/**
+ * Returns the next character on the line.
+ * Frames are sent back to back, as meters do.
+ * @return The character: 7 bits, with the even parity bit as most significant bit.
+ */
+uint8_t tic_emulator::read(void) {
+    if (m_frame_position >= m_frame_length) {
+        frame_generate();
+    }
+    uint8_t character = m_frame[m_frame_position++];
+    if (m_overload_position != 0 && m_frame_position == m_overload_position) {
+        m_overloads++;
+    }
+    return character;
+}
+
+/**
+ * Registers a function to be called for each dataset generated, before it is sent,
+ * with the name of the dataset and whether it has been corrupted.
+ * @param[in] callback The function, or NULL for none.
+ */
+void tic_emulator::dataset_callback_set(void (*callback)(const char *name, const bool corrupted)) {
+    m_dataset_callback = callback;
+}
+
+/**
+ * @return The number of frames generated so far.
+ */
+uint32_t tic_emulator::frames(void) {
+    return m_frames;
+}
+
+/**
+ * @return The number of datasets generated so far, corrupted ones included.
+ */
+uint32_t tic_emulator::datasets(void) {
+    return m_datasets;
+}
+
+/**
+ * @return The number of datasets generated so far with a wrong checksum or a flipped bit.
+ */
+uint32_t tic_emulator::datasets_corrupted(void) {
+    return m_datasets_corrupted;
+}
+
+/**
+ * @return The number of characters generated so far with a flipped bit.
+ */
+uint32_t tic_emulator::characters_corrupted(void) {
+    return m_characters_corrupted;
+}
+
+/**
+ * @return The number of overloads started so far, each counted once the first overload warning has been sent.
+ */
+uint32_t tic_emulator::overloads(void) {
+    return m_overloads;
+}
+
+/**
+ * @return A pseudo random number, from a xorshift generator.
+ */
+uint32_t tic_emulator::random(void) {
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+}
+
+/**
+ * Appends a character to the frame, as it is on the line.
+ * The parity bit is added, and a bit might then be flipped by noise.
+ * @param[in,out] frame The frame.
+ * @param[in,out] length The length of the frame.
+ * @param[in] character The 7 bits character.
+ * @param[in] noise_bit The bit to flip, from 0 to 7, or 8 for none.
+ * @return true if a bit has been flipped, false otherwise.
+ */
+static bool character_add(char *frame, size_t &length, const char character, const uint8_t noise_bit) {
+    uint8_t data = character & 0x7F;
+    uint8_t parity = 0;
+    for (uint8_t i = data; i != 0; i >>= 1) {
+        parity ^= i & 1;
+    }
+    data |= parity << 7;
+    if (noise_bit < 8) {
+        data ^= 1 << noise_bit;
+    }
+    frame[length++] = (char)data;
+    return (noise_bit < 8);
+}
+
+/**
+ * Appends a dataset to the frame being generated, in the format of the mode of the meter:
+ * - historic: LF label SP data SP checksum CR, the checksum covering label SP data,
+ * - standard: LF label HT [horodate HT] data HT checksum CR, the checksum covering everything up to the last HT.
+ * The checksum is the sum of the characters covered, truncated to 6 bits, plus 0x20.
+ * @param[in] name The label.
+ * @param[in] horodate The horodate, only in standard mode, or NULL for none.
+ * @param[in] data The data.
+ */
+void tic_emulator::dataset_add(const char *name, const char *horodate, const char *data) {
+
+    /* Assemble dataset, from label to checksum */
+    char separator = m_standard ? TIC_HT : TIC_SP;
+    char text[128];
+    int length;
+    if (horodate != NULL) {
+        length = snprintf(text, sizeof(text), "%s%c%s%c%s", name, separator, horodate, separator, data);
+    } else {
+        length = snprintf(text, sizeof(text), "%s%c%s", name, separator, data);
+    }
+    if (m_standard) {
+        text[length++] = separator;
+    }
+    uint8_t sum = 0;
+    for (int i = 0; i < length; i++) {
+        sum += (uint8_t)text[i];
+    }
+    char checksum = (sum & 0x3F) + 0x20;
+    bool corrupted = false;
+    if (random() % 1000000 < m_checksum_ppm) {
+        checksum = ((checksum - 0x20 + 1 + random() % 63) & 0x3F) + 0x20;
+        corrupted = true;
+    }
+    if (!m_standard) {
+        text[length++] = separator;
+    }
+    text[length++] = checksum;
+
+    /* Append it, with its delimiters */
+    if (m_frame_length + length + 2 > sizeof(m_frame) - 1) {
+        return;
+    }
+    for (int i = -1; i <= length; i++) {
+        char character = (i < 0) ? TIC_LF : ((i == length) ? TIC_CR : text[i]);
+        uint8_t noise_bit = (random() % 1000000 < m_noise_ppm) ? (random() % 8) : 8;
+        if (character_add(m_frame, m_frame_length, character, noise_bit)) {
+            m_characters_corrupted++;
+            corrupted = true;
+        }
+    }
+
+    /* Account for it */
+    m_datasets++;
+    if (corrupted) {
+        m_datasets_corrupted++;
+    }
+    if (m_dataset_callback != NULL) {
+        m_dataset_callback(name, corrupted);
+    }
+}
+
+/**
+ * Appends a dataset with a number as data, padded with zeros.
+ * @param[in] name The label.
+ * @param[in] value The value.
+ * @param[in] digits The number of digits, at most 15.
+ */
+void tic_emulator::dataset_add_number(const char *name, const uint32_t value, const uint8_t digits) {
+    char data[16];
+    snprintf(data, sizeof(data), "%0*lu", (digits < sizeof(data)) ? digits : (int)sizeof(data) - 1, (unsigned long)value);
+    dataset_add(name, NULL, data);
+}
+
+/**
+ * Generates the next frame, after having advanced the consumption model by the duration of the previous one.
+ */
+void tic_emulator::frame_generate(void) {
+
+    /* Advance consumption model
+     * Power takes small random steps, with a large one every now and then, as appliances switch on and off */
+    uint32_t duration_ms = (m_frame_length * 10 * 1000) / baudrate();
+    m_time_s += (duration_ms + 500) / 1000;
+    int32_t step = (random() % 8 == 0) ? ((int32_t)(random() % 4001) - 2000) : ((int32_t)(random() % 101) - 50);
+    int32_t power_va = (int32_t)m_power_va + step;
+    if (power_va < TIC_EMULATOR_POWER_MIN_VA) {
+        power_va = TIC_EMULATOR_POWER_MIN_VA;
+    } else if (power_va > TIC_EMULATOR_POWER_MAX_VA) {
+        power_va = TIC_EMULATOR_POWER_MAX_VA;
+    }
+    m_power_va = power_va;
+    uint8_t period = (m_time_s / TIC_EMULATOR_PERIOD_S) % 6;
+    m_energy_mwh[period] += (uint64_t)m_power_va * duration_ms / 3600;
+    uint32_t current_a = (m_power_va + TIC_EMULATOR_VOLTAGE_V / 2) / TIC_EMULATOR_VOLTAGE_V;
+    uint32_t energy_wh[6];
+    uint32_t energy_total_wh = 0;
+    for (uint8_t i = 0; i < 6; i++) {
+        energy_wh[i] = m_energy_mwh[i] / 1000;
+        energy_total_wh += energy_wh[i];
+    }
+
+    /* Start frame */
+    m_frame_length = 0;
+    m_frame_position = 0;
+    m_overload_position = 0;
+    bool overload = false;
+    character_add(m_frame, m_frame_length, TIC_STX, 8);
+
+    /* Add datasets of the contract, in the order meters send them */
+    switch (m_contract) {
+        case TIC_EMULATOR_CONTRACT_BASE:
+        case TIC_EMULATOR_CONTRACT_HC:
+        case TIC_EMULATOR_CONTRACT_EJP:
+        case TIC_EMULATOR_CONTRACT_TEMPO:
+        case TIC_EMULATOR_CONTRACT_BASE_TRIPHASE: {
+            bool triphase = (m_contract == TIC_EMULATOR_CONTRACT_BASE_TRIPHASE);
+            dataset_add("ADCO", NULL, "021861348497");
+            if (m_contract == TIC_EMULATOR_CONTRACT_HC) {
+                dataset_add("OPTARIF", NULL, "HC..");
+                dataset_add_number("ISOUSC", m_subscribed_a, 2);
+                dataset_add_number("HCHC", energy_wh[0] + energy_wh[2] + energy_wh[4], 9);
+                dataset_add_number("HCHP", energy_wh[1] + energy_wh[3] + energy_wh[5], 9);
+                dataset_add("PTEC", NULL, (period % 2 == 0) ? "HC.." : "HP..");
+            } else if (m_contract == TIC_EMULATOR_CONTRACT_EJP) {
+                dataset_add("OPTARIF", NULL, "EJP.");
+                dataset_add_number("ISOUSC", m_subscribed_a, 2);
+                dataset_add_number("EJPHN", energy_wh[0] + energy_wh[1] + energy_wh[2] + energy_wh[3] + energy_wh[4], 9);
+                dataset_add_number("EJPHPM", energy_wh[5], 9);
+                dataset_add("PTEC", NULL, (period == 5) ? "PM.." : "HN..");
+                if (period == 4) {
+                    dataset_add("PEJP", NULL, "30");
+                }
+            } else if (m_contract == TIC_EMULATOR_CONTRACT_TEMPO) {
+                static const char *const tempo_labels[6] = {"BBRHCJB", "BBRHPJB", "BBRHCJW", "BBRHPJW", "BBRHCJR", "BBRHPJR"};
+                static const char *const tempo_periods[6] = {"HCJB", "HPJB", "HCJW", "HPJW", "HCJR", "HPJR"};
+                dataset_add("OPTARIF", NULL, "BBR(");
+                dataset_add_number("ISOUSC", m_subscribed_a, 2);
+                for (uint8_t i = 0; i < 6; i++) {
+                    dataset_add_number(tempo_labels[i], energy_wh[i], 9);
+                }
+                dataset_add("PTEC", NULL, tempo_periods[period]);
+                dataset_add("DEMAIN", NULL, (period < 4) ? "BLEU" : "ROUG");
+            } else {
+                dataset_add("OPTARIF", NULL, "BASE");
+                dataset_add_number("ISOUSC", m_subscribed_a, 2);
+                dataset_add_number("BASE", energy_total_wh, 9);
+                dataset_add("PTEC", NULL, "TH..");
+            }
+            if (triphase) {
+                for (uint8_t i = 0; i < 3; i++) {
+                    char name[8];
+                    snprintf(name, sizeof(name), "IINST%u", i + 1);
+                    dataset_add_number(name, (current_a + i) / 3, 3);
+                }
+
+                /* Meters actually send overload warnings in short frames of their own, they are added to the usual one here */
+                for (uint8_t i = 0; i < 3; i++) {
+                    if ((current_a + i) / 3 > m_subscribed_a) {
+                        char name[8];
+                        snprintf(name, sizeof(name), "ADIR%u", i + 1);
+                        dataset_add_number(name, (current_a + i) / 3, 3);
+                        if (overload == false && m_overload == false) {
+                            m_overload_position = m_frame_length;
+                        }
+                        overload = true;
+                    }
+                }
+                for (uint8_t i = 0; i < 3; i++) {
+                    char name[8];
+                    snprintf(name, sizeof(name), "IMAX%u", i + 1);
+                    dataset_add_number(name, 60, 3);
+                }
+                dataset_add_number("PMAX", 12470, 5);
+                dataset_add_number("PAPP", m_power_va, 5);
+                dataset_add("HHPHC", NULL, "A");
+                dataset_add("MOTDETAT", NULL, "000000");
+                dataset_add("PPOT", NULL, "00");
+            } else {
+                dataset_add_number("IINST", current_a, 3);
+                if (current_a > m_subscribed_a) {
+                    dataset_add_number("ADPS", current_a, 3);
+                    if (overload == false && m_overload == false) {
+                        m_overload_position = m_frame_length;
+                    }
+                    overload = true;
+                }
+                dataset_add_number("IMAX", 90, 3);
+                dataset_add_number("PAPP", m_power_va, 5);
+                dataset_add("HHPHC", NULL, "A");
+                dataset_add("MOTDETAT", NULL, "000000");
+            }
+            break;
+        }
+
+        case TIC_EMULATOR_CONTRACT_STANDARD:
+        case TIC_EMULATOR_CONTRACT_STANDARD_TRIPHASE: {
+            bool triphase = (m_contract == TIC_EMULATOR_CONTRACT_STANDARD_TRIPHASE);
+            static const uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+            uint32_t day = 31 + m_time_s / 86400;
+            uint8_t month = 0;
+            while (day >= month_days[month]) {
+                day -= month_days[month];
+                month = (month + 1) % 12;
+            }
+            char horodate[16];
+            snprintf(horodate, sizeof(horodate), "H25%02u%02lu%02lu%02lu%02lu", month + 1, (unsigned long)day + 1, (unsigned long)(m_time_s / 3600) % 24, (unsigned long)(m_time_s / 60) % 60, (unsigned long)m_time_s % 60);
+            dataset_add("ADSC", NULL, "041876097752");
+            dataset_add("VTIC", NULL, "02");
+            dataset_add("DATE", horodate, "");
+            dataset_add("NGTF", NULL, "     TEMPO      ");
+            dataset_add("LTARF", NULL, (period % 2 == 0) ? "    HC  BLEU    " : "    HP  BLEU    ");
+            dataset_add_number("EAST", energy_total_wh, 9);
+            for (uint8_t i = 0; i < 10; i++) {
+                char name[8];
+                snprintf(name, sizeof(name), "EASF%02u", i + 1);
+                dataset_add_number(name, (i < 6) ? energy_wh[i] : 0, 9);
+            }
+            for (uint8_t i = 0; i < 4; i++) {
+                char name[8];
+                snprintf(name, sizeof(name), "EASD%02u", i + 1);
+                dataset_add_number(name, (i == 0) ? energy_total_wh : 0, 9);
+            }
+            dataset_add_number("EAIT", 0, 9);
+            for (uint8_t i = 0; i < (triphase ? 3 : 1); i++) {
+                char name[8];
+                snprintf(name, sizeof(name), "IRMS%u", i + 1);
+                dataset_add_number(name, triphase ? (current_a + i) / 3 : current_a, 3);
+            }
+            for (uint8_t i = 0; i < (triphase ? 3 : 1); i++) {
+                char name[8];
+                snprintf(name, sizeof(name), "URMS%u", i + 1);
+                dataset_add_number(name, TIC_EMULATOR_VOLTAGE_V + random() % 7 - 3, 3);
+            }
+            dataset_add_number("PREF", 9, 2);
+            dataset_add_number("PCOUP", 9, 2);
+            dataset_add_number("SINSTS", m_power_va, 5);
+            if (triphase) {
+                for (uint8_t i = 0; i < 3; i++) {
+                    char name[8];
+                    snprintf(name, sizeof(name), "SINSTS%u", i + 1);
+                    dataset_add_number(name, (m_power_va + i) / 3, 5);
+                }
+                for (uint8_t i = 0; i < 3; i++) {
+                    char name[8];
+                    snprintf(name, sizeof(name), "SMAXSN%u", i + 1);
+                    dataset_add(name, horodate, "03120");
+                }
+            } else {
+                dataset_add("SMAXSN", horodate, "07360");
+            }
+            dataset_add_number("SINSTI", 0, 5);
+            dataset_add("CCASN", horodate, "00830");
+            dataset_add("UMOY1", horodate, "231");
+            dataset_add("STGE", NULL, "003A0001");
+            dataset_add("PRM", NULL, "09273564738291");
+            dataset_add("RELAIS", NULL, "000");
+            dataset_add_number("NTARF", period + 1, 2);
+            dataset_add("NJOURF", NULL, "00");
+            dataset_add("NJOURF+1", NULL, "00");
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+
+    /* End frame */
+    character_add(m_frame, m_frame_length, TIC_ETX, 8);
+    m_frames++;
+    m_overload = overload;
+}
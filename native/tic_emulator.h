@@ -0,0 +1,68 @@
+#ifndef TIC_EMULATOR_H
+#define TIC_EMULATOR_H
+
+/* C/C++ libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Contracts the emulated meter can have */
+enum tic_emulator_contract {
+    TIC_EMULATOR_CONTRACT_BASE,               // Historic mode, single phase
+    TIC_EMULATOR_CONTRACT_HC,                 // Historic mode, single phase
+    TIC_EMULATOR_CONTRACT_EJP,                // Historic mode, single phase
+    TIC_EMULATOR_CONTRACT_TEMPO,              // Historic mode, single phase
+    TIC_EMULATOR_CONTRACT_BASE_TRIPHASE,      // Historic mode, three phases
+    TIC_EMULATOR_CONTRACT_STANDARD,           // Standard mode, single phase
+    TIC_EMULATOR_CONTRACT_STANDARD_TRIPHASE,  // Standard mode, three phases
+    TIC_EMULATOR_CONTRACT_COUNT,
+};
+
+/**
+ * Emulates the tic output of a linky meter, character by character.
+ * Characters are 7 bits with an even parity bit as their most significant bit, as they are on the line.
+ * Consumption follows a random walk, which is reproducible for a given seed,
+ * and errors can be injected, either as wrong checksums or as bits flipped by line noise.
+ * In historic mode, overload warnings are sent when the current exceeds the subscribed one.
+ */
+class tic_emulator {
+   public:
+    int setup(const enum tic_emulator_contract contract, const uint32_t seed);
+    void errors_set(const uint32_t checksum_ppm, const uint32_t noise_ppm);
+    void subscribed_set(const uint8_t current_a);
+    uint16_t baudrate(void);
+    uint8_t read(void);
+    void dataset_callback_set(void (*callback)(const char *name, const bool corrupted));
+    uint32_t frames(void);
+    uint32_t datasets(void);
+    uint32_t datasets_corrupted(void);
+    uint32_t characters_corrupted(void);
+    uint32_t overloads(void);
+
+   protected:
+    uint32_t random(void);
+    void frame_generate(void);
+    void dataset_add(const char *name, const char *horodate, const char *data);
+    void dataset_add_number(const char *name, const uint32_t value, const uint8_t digits);
+    enum tic_emulator_contract m_contract;
+    bool m_standard;
+    uint32_t m_random;
+    uint32_t m_checksum_ppm;
+    uint32_t m_noise_ppm;
+    uint8_t m_subscribed_a;
+    void (*m_dataset_callback)(const char *name, const bool corrupted);
+    char m_frame[1024];
+    size_t m_frame_length;
+    size_t m_frame_position;
+    size_t m_overload_position;
+    bool m_overload;
+    uint32_t m_time_s;
+    uint32_t m_power_va;
+    uint64_t m_energy_mwh[6];
+    uint32_t m_frames;
+    uint32_t m_datasets;
+    uint32_t m_datasets_corrupted;
+    uint32_t m_characters_corrupted;
+    uint32_t m_overloads;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/* Self header */
+#include "backlog.h"
+
+/* Arduino Libraries */
+#include <avr/eeprom.h>
+#include <core/MyEepromAddresses.h>
+
+/* C/C++ libraries */
+#include <errno.h>
+
+/* Ensure eeprom area fits in the one MySensors leaves to the sketch */
+#if CONFIG_EEPROM_BACKLOG_ADDRESS + CONFIG_BACKLOG_EEPROM_SIZE > 256
+#error "Backlog eeprom area must end before address 256"
+#endif
+
+/* Samples are kept in a ring of bytes, which starts in ram and can continue in eeprom
+ * Each sample is a varint (7 bits per byte, least significant first, most significant bit set when more bytes follow), which is:
+ * - 0 for a sample given as is, in the 4 bytes that follow (the first one, or one that can't be derived from the previous),
+ * - 1 for a missing sample,
+ * - n for a sample n - 2 above the previous valid one */
+#define BACKLOG_SIZE (CONFIG_BACKLOG_BUFFER_SIZE + CONFIG_BACKLOG_EEPROM_SIZE)
+#define BACKLOG_CODE_ABSOLUTE 0
+#define BACKLOG_CODE_MISSING 1
+#define BACKLOG_CODE_DELTA 2
+
+/* Working variables */
+static uint8_t m_buffer[CONFIG_BACKLOG_BUFFER_SIZE];
+static uint16_t m_head = 0;        // Where the next sample is written
+static uint16_t m_tail = 0;        // Where the oldest sample is read
+static uint16_t m_used = 0;        // Number of bytes used
+static uint16_t m_count = 0;       // Number of samples
+static uint32_t m_head_value = 0;  // Last valid value written, that the next one derives from
+static bool m_head_valid = false;  // Whether there is such a value in the ring
+static uint32_t m_tail_value = 0;  // Last valid value read, that the oldest sample derives from
+
+/**
+ * Reads a byte of the ring.
+ * @param[in] position The position in the ring.
+ * @return The byte.
+ */
+static uint8_t backlog_byte_read(const uint16_t position) {
+    if (position < CONFIG_BACKLOG_BUFFER_SIZE) {
+        return m_buffer[position];
+    }
+    return eeprom_read_byte((const uint8_t *)(uintptr_t)(EEPROM_LOCAL_CONFIG_ADDRESS + CONFIG_EEPROM_BACKLOG_ADDRESS + position - CONFIG_BACKLOG_BUFFER_SIZE));
+}
+
+/**
+ * Writes a byte at the head of the ring, and advances it.
+ * Eeprom is only written if the byte differs, to limit wear.
+ * @param[in] byte The byte.
+ */
+static void backlog_byte_push(const uint8_t byte) {
+    if (m_head < CONFIG_BACKLOG_BUFFER_SIZE) {
+        m_buffer[m_head] = byte;
+    } else {
+        eeprom_update_byte((uint8_t *)(uintptr_t)(EEPROM_LOCAL_CONFIG_ADDRESS + CONFIG_EEPROM_BACKLOG_ADDRESS + m_head - CONFIG_BACKLOG_BUFFER_SIZE), byte);
+    }
+    m_head = (m_head + 1) % BACKLOG_SIZE;
+    m_used++;
+}
+
+/**
+ * Decodes the oldest sample of the ring.
+ * @param[out] code The code of the sample.
+ * @param[out] value The value of the sample, if it is valid.
+ * @return The number of bytes of the sample.
+ */
+static uint8_t backlog_decode(uint32_t &code, uint32_t &value) {
+    uint8_t length = 0;
+    code = 0;
+    for (uint8_t shift = 0;; shift += 7) {
+        uint8_t byte = backlog_byte_read((m_tail + length) % BACKLOG_SIZE);
+        length++;
+        code |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    if (code == BACKLOG_CODE_ABSOLUTE) {
+        value = 0;
+        for (uint8_t i = 0; i < 4; i++) {
+            value |= (uint32_t)backlog_byte_read((m_tail + length) % BACKLOG_SIZE) << (8 * i);
+            length++;
+        }
+    } else if (code >= BACKLOG_CODE_DELTA) {
+        value = m_tail_value + (code - BACKLOG_CODE_DELTA);
+    }
+    return length;
+}
+
+/**
+ * Appends a sample to the backlog, as a difference with the previous one whenever possible.
+ * @param[in] value The value of the sample.
+ * @param[in] valid Whether the value is known, false to record a missing sample which keeps the following ones in step.
+ * @return 0 in case of success, or a negative error code otherwise, such as -ENOSPC when the backlog is full.
+ */
+int backlog_push(const uint32_t value, const bool valid) {
+
+    /* Choose code */
+    uint32_t code;
+    bool absolute = false;
+    if (valid == false) {
+        code = BACKLOG_CODE_MISSING;
+    } else if (m_head_valid == false || value < m_head_value || value - m_head_value > UINT32_MAX - BACKLOG_CODE_DELTA) {
+        code = BACKLOG_CODE_ABSOLUTE;
+        absolute = true;
+    } else {
+        code = value - m_head_value + BACKLOG_CODE_DELTA;
+    }
+
+    /* Ensure it fits */
+    uint8_t length = 1;
+    for (uint32_t rest = code >> 7; rest > 0; rest >>= 7) {
+        length++;
+    }
+    if (absolute == true) {
+        length += 4;
+    }
+    if (length > BACKLOG_SIZE - m_used) {
+        return -ENOSPC;
+    }
+
+    /* Write it */
+    do {
+        uint8_t byte = code & 0x7F;
+        code >>= 7;
+        backlog_byte_push((code > 0) ? (byte | 0x80) : byte);
+    } while (code > 0);
+    if (absolute == true) {
+        for (uint8_t i = 0; i < 4; i++) {
+            backlog_byte_push(value >> (8 * i));
+        }
+    }
+    if (valid == true) {
+        m_head_value = value;
+        m_head_valid = true;
+    }
+    m_count++;
+    return 0;
+}
+
+/**
+ * Retrieves the oldest sample of the backlog, without removing it.
+ * @param[out] value The value of the sample, if it is valid.
+ * @return 1 if the sample is valid, 0 if it is a missing one, or -ENOENT if the backlog is empty.
+ */
+int backlog_peek(uint32_t &value) {
+    if (m_count == 0) {
+        return -ENOENT;
+    }
+    uint32_t code;
+    backlog_decode(code, value);
+    return (code == BACKLOG_CODE_MISSING) ? 0 : 1;
+}
+
+/**
+ * Removes the oldest sample of the backlog.
+ */
+void backlog_pop(void) {
+    if (m_count == 0) {
+        return;
+    }
+    uint32_t code;
+    uint32_t value;
+    uint8_t length = backlog_decode(code, value);
+    if (code != BACKLOG_CODE_MISSING) {
+        m_tail_value = value;
+    }
+    m_tail = (m_tail + length) % BACKLOG_SIZE;
+    m_used -= length;
+    m_count--;
+    if (m_count == 0) {
+        m_head_valid = false;
+    }
+}
+
+/**
+ * Removes all samples from the backlog.
+ */
+void backlog_clear(void) {
+    m_head = 0;
+    m_tail = 0;
+    m_used = 0;
+    m_count = 0;
+    m_head_valid = false;
+}
+
+/**
+ * @return The number of samples in the backlog, missing ones included.
+ */
+uint16_t backlog_count(void) {
+    return m_count;
+}
@@ -0,0 +1,16 @@
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+/* Config */
+#include "../cfg/config.h"
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+int backlog_push(const uint32_t value, const bool valid);
+int backlog_peek(uint32_t &value);
+void backlog_pop(void);
+void backlog_clear(void);
+uint16_t backlog_count(void);
+
+#endif
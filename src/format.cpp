@@ -0,0 +1,79 @@
+/* Self header */
+#include "format.h"
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/* Powers of ten a 32 bits integer can hold, from the greatest */
+static const uint32_t m_powers[FORMAT_UINT_LENGTH_MAX] PROGMEM = {
+    1000000000UL,
+    100000000UL,
+    10000000UL,
+    1000000UL,
+    100000UL,
+    10000UL,
+    1000UL,
+    100UL,
+    10UL,
+    1UL,
+};
+
+/**
+ * Writes an integer in decimal.
+ * Digits are found by repeated subtraction of powers of ten, as divisions are very slow on avr.
+ * @param[out] buffer The buffer to write into, of at least FORMAT_UINT_LENGTH_MAX + 1 characters.
+ * @param[in] value The integer.
+ * @param[in] digits_min The minimum number of digits, the integer is padded with zeros up to that number.
+ * @return The number of characters written, without the terminating null character.
+ */
+uint8_t format_uint(char *buffer, uint32_t value, uint8_t digits_min) {
+    uint8_t length = 0;
+    for (uint8_t i = 0; i < FORMAT_UINT_LENGTH_MAX; i++) {
+        uint32_t power = pgm_read_dword(&m_powers[i]);
+        char digit = '0';
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        if (length > 0 || digit != '0' || FORMAT_UINT_LENGTH_MAX - i <= digits_min) {
+            buffer[length++] = digit;
+        }
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+/**
+ * Writes an integer in thousandths as a decimal number with three decimals, for example Wh as kWh.
+ * @param[out] buffer The buffer to write into, of at least FORMAT_MILLI_LENGTH_MAX + 1 characters.
+ * @param[in] value The integer, in thousandths.
+ * @return The number of characters written, without the terminating null character.
+ */
+uint8_t format_milli(char *buffer, uint32_t value) {
+    uint8_t length = format_uint(buffer, value, 4);
+    for (uint8_t i = length; i > length - 3; i--) {
+        buffer[i] = buffer[i - 1];
+    }
+    buffer[length - 3] = '.';
+    buffer[length + 1] = '\0';
+    return length + 1;
+}
+
+/**
+ * Writes integers in decimal, separated by colons.
+ * @param[out] buffer The buffer to write into, of at least (FORMAT_UINT_LENGTH_MAX + 1) * count characters.
+ * @param[in] values The integers.
+ * @param[in] count The number of integers.
+ * @return The number of characters written, without the terminating null character.
+ */
+uint8_t format_list(char *buffer, const uint32_t *values, uint8_t count) {
+    uint8_t length = 0;
+    buffer[0] = '\0';
+    for (uint8_t i = 0; i < count; i++) {
+        if (i > 0) {
+            buffer[length++] = ':';
+        }
+        length += format_uint(&buffer[length], values[i]);
+    }
+    return length;
+}
@@ -0,0 +1,15 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+/* C/C++ libraries */
+#include <stdint.h>
+
+/* Maximum length of formatted numbers, without the terminating null character */
+#define FORMAT_UINT_LENGTH_MAX 10
+#define FORMAT_MILLI_LENGTH_MAX 11
+
+uint8_t format_uint(char *buffer, uint32_t value, uint8_t digits_min = 1);
+uint8_t format_milli(char *buffer, uint32_t value);
+uint8_t format_list(char *buffer, const uint32_t *values, uint8_t count);
+
+#endif
@@ -0,0 +1,103 @@
+/* Self header */
+#include "log.h"
+
+/* C/C++ libraries */
+#include <stdarg.h>
+#include <stdio.h>
+
+/* Ensure buffer size allows cheap index wrapping */
+#if (CONFIG_LOG_BUFFER_SIZE & (CONFIG_LOG_BUFFER_SIZE - 1)) != 0 || CONFIG_LOG_BUFFER_SIZE > 256
+#error "CONFIG_LOG_BUFFER_SIZE must be a power of two no greater than 256"
+#endif
+
+/* Working variables */
+static uint8_t m_level = LOG_LEVEL_DEBUG;
+static char m_buffer[CONFIG_LOG_BUFFER_SIZE];
+static uint8_t m_buffer_head = 0;
+static uint8_t m_buffer_tail = 0;
+static uint16_t m_dropped = 0;
+static uint16_t m_dropped_reported = 0;
+
+/**
+ * Sets the runtime log level, messages above it are dropped.
+ * @param[in] level The log level, from LOG_LEVEL_NONE to LOG_LEVEL_DEBUG.
+ */
+void log_level_set(const uint8_t level) {
+    m_level = level;
+}
+
+/**
+ * Formats a message into the log buffer, without waiting for it to be output.
+ * If the buffer doesn't have enough room left, the message is dropped and counted.
+ * @param[in] level The log level of the message.
+ * @param[in] format The printf like format of the message, in flash.
+ */
+void log_write_P(const uint8_t level, PGM_P format, ...) {
+
+    /* Apply runtime level */
+    if (level > m_level) {
+        return;
+    }
+
+    /* Format message, with its level and end of line */
+    static const char prefixes[] PROGMEM = "?ewid";
+    char line[CONFIG_LOG_LINE_LENGTH_MAX + 1];
+    line[0] = ' ';
+    line[1] = '[';
+    line[2] = pgm_read_byte(&prefixes[level < sizeof(prefixes) - 1 ? level : 0]);
+    line[3] = ']';
+    line[4] = ' ';
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf_P(&line[5], sizeof(line) - 5 - 2, format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    length += 5;
+    if (length > (int)sizeof(line) - 3) {
+        length = sizeof(line) - 3;
+    }
+    line[length++] = '\r';
+    line[length++] = '\n';
+
+    /* Push message into buffer, as a whole or not at all */
+    uint8_t room = (uint8_t)(m_buffer_tail - m_buffer_head - 1) & (CONFIG_LOG_BUFFER_SIZE - 1);
+    if (length > room) {
+        m_dropped++;
+        return;
+    }
+    for (int i = 0; i < length; i++) {
+        m_buffer[m_buffer_head] = line[i];
+        m_buffer_head = (m_buffer_head + 1) & (CONFIG_LOG_BUFFER_SIZE - 1);
+    }
+}
+
+/**
+ * Outputs as much of the log buffer as possible without blocking.
+ * Meant to be called when there is nothing else to do.
+ * @param[in] output Where to output messages.
+ */
+void log_flush(Print &output) {
+
+    /* Report dropped messages */
+    if (m_dropped != m_dropped_reported && m_buffer_head == m_buffer_tail) {
+        m_dropped_reported = m_dropped;
+        log_write_P(LOG_LEVEL_WARNING, PSTR("%u log messages dropped so far"), m_dropped);
+    }
+
+    /* Output only what fits into the output buffer */
+    int room = output.availableForWrite();
+    while (room > 0 && m_buffer_head != m_buffer_tail) {
+        output.write(m_buffer[m_buffer_tail]);
+        m_buffer_tail = (m_buffer_tail + 1) & (CONFIG_LOG_BUFFER_SIZE - 1);
+        room--;
+    }
+}
+
+/**
+ * @return The number of messages dropped because the log buffer was full.
+ */
+uint16_t log_dropped(void) {
+    return m_dropped;
+}
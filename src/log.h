@@ -0,0 +1,36 @@
+#ifndef LOG_H
+#define LOG_H
+
+/* Config */
+#include "../cfg/config.h"
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/* Log levels */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+/* Logging macros, taking the name of the module as first parameter
+ * Messages above the compile time level of the module (CONFIG_LOG_LEVEL_<module>) compile to nothing,
+ * and those above the runtime level are dropped */
+#define LOG_E(module, format, ...) LOG_WRITE(module, LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define LOG_W(module, format, ...) LOG_WRITE(module, LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#define LOG_I(module, format, ...) LOG_WRITE(module, LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_D(module, format, ...) LOG_WRITE(module, LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define LOG_WRITE(module, level, format, ...)                  \
+    do {                                                       \
+        if (CONFIG_LOG_LEVEL_##module >= (level)) {            \
+            log_write_P((level), PSTR(format), ##__VA_ARGS__); \
+        }                                                      \
+    } while (0)
+
+void log_level_set(const uint8_t level);
+void log_write_P(const uint8_t level, PGM_P format, ...);
+void log_flush(Print &output);
+uint16_t log_dropped(void);
+
+#endif
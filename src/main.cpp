@@ -4,23 +4,53 @@
 /* Arduino Libraries */
 #include <Arduino.h>
 #include <MySensors.h>
-#include <SoftwareSerial.h>
-#include <tic_reader.h>
+
+/* Project code */
+#include "backlog.h"
+#include "format.h"
+#include "log.h"
+#include "memory.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "supply_monitor.h"
+#include "tic_autobaud.h"
+#include "tic_parser.h"
+#include "tic_uart.h"
 
 /* C/C++ libraries */
 #include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Working variables */
-static SoftwareSerial m_tic_port(CONFIG_TIC_DATA_PIN, CONFIG_TIC_DUMMY_PIN);
-static uint16_t m_tic_port_baudrate = 0;
-static tic_reader m_tic_reader;
+static tic_uart m_tic_port;
+static uint16_t m_tic_port_baudrate = 0;  // Last baud rate detected or at which datasets were received, 0 if none
+static tic_autobaud m_tic_autobaud;
+static supply_monitor m_supply;
+static tic_parser m_tic_parser;
 static enum {
     STATE_STARTING,
     STATE_VALID,
     STATE_INVALID,
 } m_tic_state;
 
+/* Contracts a meter can be on, which decide the sensors it feeds
+ * Learned from the contract name, and kept in eeprom so that only those sensors are presented at startup */
+enum {
+    CONTRACT_BASE,      // Historic mode, option Base
+    CONTRACT_HC,        // Historic mode, option Heures Creuses
+    CONTRACT_EJP,       // Historic mode, option EJP
+    CONTRACT_TEMPO,     // Historic mode, option Tempo
+    CONTRACT_STANDARD,  // Standard mode, whatever the calendar, as indexes are then numbered rather than named
+    CONTRACT_COUNT,
+    CONTRACT_UNKNOWN = 0xFF,
+};
+#define CONTRACTS_ALL ((1 << CONTRACT_COUNT) - 1)
+#define CONTRACTS_HISTORIC ((1 << CONTRACT_BASE) | (1 << CONTRACT_HC) | (1 << CONTRACT_EJP) | (1 << CONTRACT_TEMPO))
+static uint8_t m_contract = CONTRACT_UNKNOWN;  // All sensors are presented and fed until it is known
+
 /* List of virtual sensors */
 enum {
     SENSOR_0_SERIAL_NUMBER,                   // S_INFO (V_TEXT)
@@ -44,673 +74,2268 @@ enum {
     SENSOR_18_CONTRACT_TEMPO_INDEX_RED_PK,    // S_POWER (V_KWH)
     SENSOR_19_CONTRACT_TEMPO_INDEX_RED_OK,    // S_POWER (V_KWH)
     SENSOR_20_CONTRACT_TEMPO_TOMORROW,        // S_INFO (V_TEXT)
+    SENSOR_21_ENERGY_DELIVERED_TOTAL,         // S_POWER (V_KWH)
+    SENSOR_22_ENERGY_DELIVERED_INDEX_01,      // S_POWER (V_KWH)
+    SENSOR_23_ENERGY_DELIVERED_INDEX_02,      // S_POWER (V_KWH)
+    SENSOR_24_ENERGY_DELIVERED_INDEX_03,      // S_POWER (V_KWH)
+    SENSOR_25_ENERGY_DELIVERED_INDEX_04,      // S_POWER (V_KWH)
+    SENSOR_26_ENERGY_DELIVERED_INDEX_05,      // S_POWER (V_KWH)
+    SENSOR_27_ENERGY_DELIVERED_INDEX_06,      // S_POWER (V_KWH)
+    SENSOR_28_ENERGY_DELIVERED_INDEX_07,      // S_POWER (V_KWH)
+    SENSOR_29_ENERGY_DELIVERED_INDEX_08,      // S_POWER (V_KWH)
+    SENSOR_30_ENERGY_DELIVERED_INDEX_09,      // S_POWER (V_KWH)
+    SENSOR_31_ENERGY_DELIVERED_INDEX_10,      // S_POWER (V_KWH)
+    SENSOR_32_ENERGY_INJECTED_TOTAL,          // S_POWER (V_KWH)
+    SENSOR_33_POWER_APPARENT_PHASE_1,         // S_POWER (V_WATT)
+    SENSOR_34_POWER_APPARENT_PHASE_2,         // S_POWER (V_WATT)
+    SENSOR_35_POWER_APPARENT_PHASE_3,         // S_POWER (V_WATT)
+    SENSOR_36_POWER_APPARENT_INJECTED,        // S_POWER (V_WATT)
+    SENSOR_37_POWER_APPARENT_MAX_PHASE_1,     // S_POWER (V_WATT)
+    SENSOR_38_POWER_APPARENT_MAX_PHASE_2,     // S_POWER (V_WATT)
+    SENSOR_39_POWER_APPARENT_MAX_PHASE_3,     // S_POWER (V_WATT)
+    SENSOR_40_STATUS,                         // S_INFO (V_TEXT)
+    SENSOR_41_CONFIGURATION,                  // S_CUSTOM (V_VAR1 to V_VAR5 and V_CUSTOM)
+    SENSOR_42_DIAGNOSTICS,                    // S_CUSTOM (V_VAR1 to V_VAR5 and V_CUSTOM)
+    SENSOR_43_POWER_ACTIVE,                   // S_POWER (V_WATT)
+    SENSOR_44_HISTORY,                        // S_CUSTOM (V_VAR1)
+    SENSOR_45_PACKED,                         // S_CUSTOM (V_CUSTOM)
+    SENSOR_46_ALERT,                          // S_INFO (V_TEXT)
+    SENSOR_COUNT,
+};
+
+/* Presentation of virtual sensors, in the same order as the list above
+ * Names must fit in a message payload (25 bytes) */
+struct sensor {
+    uint8_t type;
+    uint8_t contracts;  // Contracts it is used in, as a bit mask
+    char name[25 + 1];
+};
+static const struct sensor m_sensors[SENSOR_COUNT] PROGMEM = {
+    {S_INFO, CONTRACTS_ALL, "Numéro de Série"},                    // V_TEXT (ADCO, ADSC)
+    {S_MULTIMETER, CONTRACTS_ALL, "Phase 1"},                      // V_VOLTAGE (URMS1) and V_CURRENT (IINST, IINST1, IRMS1)
+    {S_MULTIMETER, CONTRACTS_ALL, "Phase 2"},                      // V_VOLTAGE (URMS2) and V_CURRENT (IINST2, IRMS2)
+    {S_MULTIMETER, CONTRACTS_ALL, "Phase 3"},                      // V_VOLTAGE (URMS3) and V_CURRENT (IINST3, IRMS3)
+    {S_POWER, CONTRACTS_ALL, "Puissance Apparente"},               // V_WATT (PAPP, SINSTS)
+    {S_INFO, CONTRACTS_ALL, "Option Tarifaire"},                   // V_TEXT (OPTARIF, NGTF)
+    {S_MULTIMETER, CONTRACTS_HISTORIC, "Intensité Souscrite"},     // V_CURRENT (ISOUSC)
+    {S_INFO, CONTRACTS_ALL, "Période Tarifaire"},                  // V_TEXT (PTEC, LTARF)
+    {S_POWER, (1 << CONTRACT_BASE), "Index TH"},                   // V_KWH (BASE)
+    {S_POWER, (1 << CONTRACT_HC), "Index HC"},                     // V_KWH (HCHC)
+    {S_POWER, (1 << CONTRACT_HC), "Index HP"},                     // V_KWH (HCHP)
+    {S_POWER, (1 << CONTRACT_EJP), "Index HN"},                    // V_KWH (EJPHN)
+    {S_POWER, (1 << CONTRACT_EJP), "Index HPM"},                   // V_KWH (EJPHPM)
+    {S_INFO, (1 << CONTRACT_EJP), "Préavis EJP"},                  // V_TEXT (PEJP)
+    {S_POWER, (1 << CONTRACT_TEMPO), "Index Bleu HP"},             // V_KWH (BBRHPJB)
+    {S_POWER, (1 << CONTRACT_TEMPO), "Index Bleu HC"},             // V_KWH (BBRHCJB)
+    {S_POWER, (1 << CONTRACT_TEMPO), "Index Blanc HP"},            // V_KWH (BBRHPJW)
+    {S_POWER, (1 << CONTRACT_TEMPO), "Index Blanc HC"},            // V_KWH (BBRHCJW)
+    {S_POWER, (1 << CONTRACT_TEMPO), "Index Rouge HP"},            // V_KWH (BBRHPJR)
+    {S_POWER, (1 << CONTRACT_TEMPO), "Index Rouge HC"},            // V_KWH (BBRHCJR)
+    {S_INFO, (1 << CONTRACT_TEMPO), "Couleur Demain"},             // V_TEXT (DEMAIN)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Total Soutiré"},    // V_KWH (EAST)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 1"},    // V_KWH (EASF01)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 2"},    // V_KWH (EASF02)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 3"},    // V_KWH (EASF03)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 4"},    // V_KWH (EASF04)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 5"},    // V_KWH (EASF05)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 6"},    // V_KWH (EASF06)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 7"},    // V_KWH (EASF07)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 8"},    // V_KWH (EASF08)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 9"},    // V_KWH (EASF09)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Fournisseur 10"},   // V_KWH (EASF10)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Index Total Injecté"},    // V_KWH (EAIT)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Puissance Phase 1"},      // V_WATT (SINSTS1)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Puissance Phase 2"},      // V_WATT (SINSTS2)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Puissance Phase 3"},      // V_WATT (SINSTS3)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Puissance Injectée"},     // V_WATT (SINSTI)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Puissance Max Phase 1"},  // V_WATT (SMAXSN, SMAXSN1)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Puissance Max Phase 2"},  // V_WATT (SMAXSN2)
+    {S_POWER, (1 << CONTRACT_STANDARD), "Puissance Max Phase 3"},  // V_WATT (SMAXSN3)
+    {S_INFO, (1 << CONTRACT_STANDARD), "Registre de Statuts"},     // V_TEXT (STGE)
+    {S_CUSTOM, CONTRACTS_ALL, "Configuration"},                    // V_VAR1 to V_VAR5 and V_CUSTOM
+    {S_CUSTOM, CONTRACTS_ALL, "Diagnostics"},                      // V_VAR1 to V_VAR4 and V_CUSTOM
+    {S_POWER, CONTRACTS_ALL, "Puissance Active"},                  // V_WATT (derived from indexes)
+    {S_CUSTOM, CONTRACTS_ALL, "Historique"},                       // V_VAR1 (energy sampled while the gateway couldn't be reached)
+    {S_CUSTOM, CONTRACTS_ALL, "Valeurs Groupées"},                 // V_CUSTOM (values packed together, if CONFIG_PACKED_ENABLED is set)
+    {S_INFO, CONTRACTS_HISTORIC, "Alerte Dépassement"},            // V_TEXT (ADPS, ADIR1, ADIR2, ADIR3, and IINST close to ISOUSC)
+};
+
+/* Kinds of values carried by datasets */
+enum {
+    KIND_U8,    // Decimal integer, sent as uint8_t
+    KIND_U16,   // Decimal integer, sent as uint16_t
+    KIND_U32,   // Decimal integer, sent as uint32_t
+    KIND_KWH,   // Index in Wh, sent in kWh with 3 decimals
+    KIND_TEXT,  // Text, cut at the first '.' and without surrounding spaces
+    KIND_HEX,   // Hexadecimal integer, sent as a text of 8 digits
+    KIND_WORD,  // Text among the few known words, kept as its index in the list of words
+};
+
+/* Rules deciding whether a value has changed */
+enum {
+    RULE_CHANGED,    // When different from the last value sent
+    RULE_INCREASED,  // When greater than the last value sent
+};
+
+/* Reporting policies, deciding when values are sent */
+enum {
+    POLICY_STATE,    // Texts and settings, sent as soon as they change
+    POLICY_CURRENT,  // Currents, in A
+    POLICY_VOLTAGE,  // Voltages, in V
+    POLICY_POWER,    // Powers, in VA
+    POLICY_INDEX,    // Indexes, in Wh
+    POLICY_COUNT,
+};
+
+/* Priorities of values, deciding the order in which they are sent, derived from their reporting policy */
+enum {
+    PRIORITY_HIGH,    // Texts and settings, such as the tariff period, which drive automations
+    PRIORITY_MEDIUM,  // Instantaneous values, and their summaries
+    PRIORITY_LOW,     // Indexes
+    PRIORITY_COUNT,
+};
+struct policy {
+    uint8_t rule;
+    uint16_t deadband;         // Changes not greater than this are ignored
+    uint8_t deadband_percent;  // Same, in percents of the last value sent, the greatest deadband applies
+    uint16_t interval_min_s;   // Minimum time between two values sent
+    uint16_t interval_max_s;   // Maximum time between two values sent, after which the value is sent even if unchanged (0 to disable)
+};
+
+/* Settings, which can be changed by the controller and are saved in eeprom
+ * The version must be increased whenever the structure changes */
+#define SETTINGS_VERSION 1
+#define SETTINGS_TX_GAP_MS_MAX 1000
+struct settings {
+    uint8_t version;
+    struct policy policies[POLICY_COUNT];
+    uint8_t policies_enabled;  // Bit mask of policies whose values are sent, each policy acting as a group of sensors
+    uint8_t log_level;
+    uint16_t tx_gap_ms;
+    uint8_t crc;
+};
+static const struct settings m_settings_default PROGMEM = {
+    SETTINGS_VERSION,
+    {
+        {RULE_CHANGED, 0, 0, 0, 3600},    // POLICY_STATE
+        {RULE_CHANGED, 0, 0, 10, 300},    // POLICY_CURRENT
+        {RULE_CHANGED, 2, 0, 30, 300},    // POLICY_VOLTAGE
+        {RULE_CHANGED, 10, 5, 10, 300},   // POLICY_POWER
+        {RULE_INCREASED, 0, 0, 60, 900},  // POLICY_INDEX
+    },
+    (1 << POLICY_COUNT) - 1,  // All policies enabled
+    LOG_LEVEL_INFO,
+    CONFIG_TX_GAP_MS,
+    0,
+};
+static struct settings m_settings;
+
+/* Presentation progress */
+static int8_t m_presentation_step = -1;  // -1 for sketch information, a sensor, or SENSOR_COUNT when done
+
+/* List of texts received, kept until they are sent
+ * Only for free texts, others are kept as numbers or as words */
+#define TEXT_LENGTH_MAX 16
+enum {
+    TEXT_SERIAL_NUMBER,
+    TEXT_CONTRACT_NAME,
+    TEXT_CONTRACT_PERIOD,
+    TEXT_COUNT,
+    TEXT_NONE = 0xFF,
+};
+static char m_texts[TEXT_COUNT][TEXT_LENGTH_MAX + 1];
+
+/* List of words texts can be, for texts that can only be one of a few */
+#define WORD_LENGTH_MAX 4
+static const char m_words[][WORD_LENGTH_MAX + 1] PROGMEM = {
+    "----",  // Option Tempo, couleur du lendemain inconnue
+    "BLEU",  // Option Tempo, jour bleu
+    "BLAN",  // Option Tempo, jour blanc
+    "ROUG",  // Option Tempo, jour rouge
+};
+#define WORD_COUNT (sizeof(m_words) / sizeof(m_words[0]))
+
+/* List of values sent to the controller
+ * Each one is a sensor and variable type pair, and remembers the last value received and sent */
+enum {
+    CHANNEL_SERIAL_NUMBER,
+    CHANNEL_PHASE_1_CURRENT,
+    CHANNEL_PHASE_1_VOLTAGE,
+    CHANNEL_PHASE_2_CURRENT,
+    CHANNEL_PHASE_2_VOLTAGE,
+    CHANNEL_PHASE_3_CURRENT,
+    CHANNEL_PHASE_3_VOLTAGE,
+    CHANNEL_POWER_APPARENT,
+    CHANNEL_CONTRACT_NAME,
+    CHANNEL_CONTRACT_CURRENT,
+    CHANNEL_CONTRACT_PERIOD,
+    CHANNEL_CONTRACT_BASE_INDEX,
+    CHANNEL_CONTRACT_HC_INDEX_HC,
+    CHANNEL_CONTRACT_HC_INDEX_HP,
+    CHANNEL_CONTRACT_EJP_INDEX_HN,
+    CHANNEL_CONTRACT_EJP_INDEX_HPM,
+    CHANNEL_CONTRACT_EJP_NOTICE,
+    CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_PK,
+    CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_OK,
+    CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_PK,
+    CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_OK,
+    CHANNEL_CONTRACT_TEMPO_INDEX_RED_PK,
+    CHANNEL_CONTRACT_TEMPO_INDEX_RED_OK,
+    CHANNEL_CONTRACT_TEMPO_TOMORROW,
+    CHANNEL_ENERGY_DELIVERED_TOTAL,
+    CHANNEL_ENERGY_DELIVERED_INDEX_01,
+    CHANNEL_ENERGY_DELIVERED_INDEX_02,
+    CHANNEL_ENERGY_DELIVERED_INDEX_03,
+    CHANNEL_ENERGY_DELIVERED_INDEX_04,
+    CHANNEL_ENERGY_DELIVERED_INDEX_05,
+    CHANNEL_ENERGY_DELIVERED_INDEX_06,
+    CHANNEL_ENERGY_DELIVERED_INDEX_07,
+    CHANNEL_ENERGY_DELIVERED_INDEX_08,
+    CHANNEL_ENERGY_DELIVERED_INDEX_09,
+    CHANNEL_ENERGY_DELIVERED_INDEX_10,
+    CHANNEL_ENERGY_INJECTED_TOTAL,
+    CHANNEL_POWER_APPARENT_PHASE_1,
+    CHANNEL_POWER_APPARENT_PHASE_2,
+    CHANNEL_POWER_APPARENT_PHASE_3,
+    CHANNEL_POWER_APPARENT_INJECTED,
+    CHANNEL_POWER_APPARENT_MAX_PHASE_1,
+    CHANNEL_POWER_APPARENT_MAX_PHASE_2,
+    CHANNEL_POWER_APPARENT_MAX_PHASE_3,
+    CHANNEL_STATUS,
+    CHANNEL_POWER_ACTIVE,
+    CHANNEL_OVERLOAD,
+    CHANNEL_COUNT,
+};
+struct channel {
+    uint8_t sensor;
+    uint8_t type;
+    uint8_t kind;
+    uint8_t policy;
+    uint8_t text;  // Where the text is kept until it is sent, for texts only
+};
+static const struct channel m_channels[CHANNEL_COUNT] PROGMEM = {
+    {SENSOR_0_SERIAL_NUMBER, V_TEXT, KIND_TEXT, POLICY_STATE, TEXT_SERIAL_NUMBER},        // CHANNEL_SERIAL_NUMBER
+    {SENSOR_1_MULTIMETER_PHASE_1, V_CURRENT, KIND_U8, POLICY_CURRENT, TEXT_NONE},         // CHANNEL_PHASE_1_CURRENT
+    {SENSOR_1_MULTIMETER_PHASE_1, V_VOLTAGE, KIND_U16, POLICY_VOLTAGE, TEXT_NONE},        // CHANNEL_PHASE_1_VOLTAGE
+    {SENSOR_2_MULTIMETER_PHASE_2, V_CURRENT, KIND_U8, POLICY_CURRENT, TEXT_NONE},         // CHANNEL_PHASE_2_CURRENT
+    {SENSOR_2_MULTIMETER_PHASE_2, V_VOLTAGE, KIND_U16, POLICY_VOLTAGE, TEXT_NONE},        // CHANNEL_PHASE_2_VOLTAGE
+    {SENSOR_3_MULTIMETER_PHASE_3, V_CURRENT, KIND_U8, POLICY_CURRENT, TEXT_NONE},         // CHANNEL_PHASE_3_CURRENT
+    {SENSOR_3_MULTIMETER_PHASE_3, V_VOLTAGE, KIND_U16, POLICY_VOLTAGE, TEXT_NONE},        // CHANNEL_PHASE_3_VOLTAGE
+    {SENSOR_4_POWER_APPARENT, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},                 // CHANNEL_POWER_APPARENT
+    {SENSOR_5_CONTRACT_NAME, V_TEXT, KIND_TEXT, POLICY_STATE, TEXT_CONTRACT_NAME},        // CHANNEL_CONTRACT_NAME
+    {SENSOR_6_CONTRACT_CURRENT, V_CURRENT, KIND_U8, POLICY_STATE, TEXT_NONE},             // CHANNEL_CONTRACT_CURRENT
+    {SENSOR_7_CONTRACT_PERIOD, V_TEXT, KIND_TEXT, POLICY_STATE, TEXT_CONTRACT_PERIOD},    // CHANNEL_CONTRACT_PERIOD
+    {SENSOR_8_CONTRACT_BASE_INDEX, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},             // CHANNEL_CONTRACT_BASE_INDEX
+    {SENSOR_9_CONTRACT_HC_INDEX_HC, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},            // CHANNEL_CONTRACT_HC_INDEX_HC
+    {SENSOR_10_CONTRACT_HC_INDEX_HP, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},           // CHANNEL_CONTRACT_HC_INDEX_HP
+    {SENSOR_11_CONTRACT_EJP_INDEX_HN, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},          // CHANNEL_CONTRACT_EJP_INDEX_HN
+    {SENSOR_12_CONTRACT_EJP_INDEX_HPM, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},         // CHANNEL_CONTRACT_EJP_INDEX_HPM
+    {SENSOR_13_CONTRACT_EJP_NOTICE, V_TEXT, KIND_U8, POLICY_STATE, TEXT_NONE},            // CHANNEL_CONTRACT_EJP_NOTICE
+    {SENSOR_14_CONTRACT_TEMPO_INDEX_BLUE_PK, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},   // CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_PK
+    {SENSOR_15_CONTRACT_TEMPO_INDEX_BLUE_OK, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},   // CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_OK
+    {SENSOR_16_CONTRACT_TEMPO_INDEX_WHITE_PK, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},  // CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_PK
+    {SENSOR_17_CONTRACT_TEMPO_INDEX_WHITE_OK, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},  // CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_OK
+    {SENSOR_18_CONTRACT_TEMPO_INDEX_RED_PK, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},    // CHANNEL_CONTRACT_TEMPO_INDEX_RED_PK
+    {SENSOR_19_CONTRACT_TEMPO_INDEX_RED_OK, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},    // CHANNEL_CONTRACT_TEMPO_INDEX_RED_OK
+    {SENSOR_20_CONTRACT_TEMPO_TOMORROW, V_TEXT, KIND_WORD, POLICY_STATE, TEXT_NONE},      // CHANNEL_CONTRACT_TEMPO_TOMORROW
+    {SENSOR_21_ENERGY_DELIVERED_TOTAL, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},         // CHANNEL_ENERGY_DELIVERED_TOTAL
+    {SENSOR_22_ENERGY_DELIVERED_INDEX_01, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_01
+    {SENSOR_23_ENERGY_DELIVERED_INDEX_02, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_02
+    {SENSOR_24_ENERGY_DELIVERED_INDEX_03, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_03
+    {SENSOR_25_ENERGY_DELIVERED_INDEX_04, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_04
+    {SENSOR_26_ENERGY_DELIVERED_INDEX_05, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_05
+    {SENSOR_27_ENERGY_DELIVERED_INDEX_06, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_06
+    {SENSOR_28_ENERGY_DELIVERED_INDEX_07, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_07
+    {SENSOR_29_ENERGY_DELIVERED_INDEX_08, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_08
+    {SENSOR_30_ENERGY_DELIVERED_INDEX_09, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_09
+    {SENSOR_31_ENERGY_DELIVERED_INDEX_10, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},      // CHANNEL_ENERGY_DELIVERED_INDEX_10
+    {SENSOR_32_ENERGY_INJECTED_TOTAL, V_KWH, KIND_KWH, POLICY_INDEX, TEXT_NONE},          // CHANNEL_ENERGY_INJECTED_TOTAL
+    {SENSOR_33_POWER_APPARENT_PHASE_1, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},        // CHANNEL_POWER_APPARENT_PHASE_1
+    {SENSOR_34_POWER_APPARENT_PHASE_2, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},        // CHANNEL_POWER_APPARENT_PHASE_2
+    {SENSOR_35_POWER_APPARENT_PHASE_3, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},        // CHANNEL_POWER_APPARENT_PHASE_3
+    {SENSOR_36_POWER_APPARENT_INJECTED, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},       // CHANNEL_POWER_APPARENT_INJECTED
+    {SENSOR_37_POWER_APPARENT_MAX_PHASE_1, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},    // CHANNEL_POWER_APPARENT_MAX_PHASE_1
+    {SENSOR_38_POWER_APPARENT_MAX_PHASE_2, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},    // CHANNEL_POWER_APPARENT_MAX_PHASE_2
+    {SENSOR_39_POWER_APPARENT_MAX_PHASE_3, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},    // CHANNEL_POWER_APPARENT_MAX_PHASE_3
+    {SENSOR_40_STATUS, V_TEXT, KIND_HEX, POLICY_STATE, TEXT_NONE},                        // CHANNEL_STATUS
+    {SENSOR_43_POWER_ACTIVE, V_WATT, KIND_U32, POLICY_POWER, TEXT_NONE},                  // CHANNEL_POWER_ACTIVE
+    {SENSOR_46_ALERT, V_TEXT, KIND_U16, POLICY_STATE, TEXT_NONE},                         // CHANNEL_OVERLOAD (sent as an alert, never as a value)
+};
+
+/* State of the channels, all in one table so that its size is known at a glance: 11 bytes per channel */
+#define CHANNEL_FLAG_RECEIVED 0x01  // A value has been received in the current frame
+#define CHANNEL_FLAG_REPORTED 0x02  // A value has ever been sent
+#define CHANNEL_FLAG_DIRTY 0x04     // The value received needs to be sent
+#define CHANNEL_FLAG_SYNCED 0x08    // The value sent is known to have been received packed, so the next one can be sent as a difference
+#define CHANNEL_FLAG_SKIPPED 0x10   // The value failed to be sent in the current burst, and waits for the next one
+#define CHANNEL_FLAG_KNOWN 0x20     // A value has been received since startup, the last one being kept even if the next frames miss it
+static struct {
+    uint32_t value;   // Last value received, or hash of it for free texts
+    uint32_t sent;    // Last value sent, or hash of it for free texts
+    uint16_t sent_s;  // When the last value was sent, in seconds since startup (wraps around)
+    uint8_t flags;    // CHANNEL_FLAG_*
+} m_channels_state[CHANNEL_COUNT];
+static uint8_t m_channels_cursor = CHANNEL_COUNT;  // Next channel to send, highest priority first, or CHANNEL_COUNT when done
+static uint32_t m_packed_resync_timestamp = 0;     // When channels were last all marked to be sent in full, if values are packed
+
+/* List of dataset labels we're interested in, and the channel each one feeds
+ * Must be kept sorted in strcmp order, as the parser narrows it down as characters of a label arrive */
+struct label {
+    char name[TIC_PARSER_NAME_LENGTH_MAX + 1];
+    uint8_t channel;
+};
+static const struct label m_labels[] PROGMEM = {
+    {"ADCO", CHANNEL_SERIAL_NUMBER},                     // Adresse du compteur
+    {"ADIR1", CHANNEL_OVERLOAD},                         // Avertissement de dépassement d'intensité de réglage phase 1
+    {"ADIR2", CHANNEL_OVERLOAD},                         // Avertissement de dépassement d'intensité de réglage phase 2
+    {"ADIR3", CHANNEL_OVERLOAD},                         // Avertissement de dépassement d'intensité de réglage phase 3
+    {"ADPS", CHANNEL_OVERLOAD},                          // Avertissement de dépassement de puissance souscrite
+    {"ADSC", CHANNEL_SERIAL_NUMBER},                     // Adresse secondaire du compteur
+    {"BASE", CHANNEL_CONTRACT_BASE_INDEX},               // Option Base, index TH
+    {"BBRHCJB", CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_OK},   // Option Tempo, index bleu HC
+    {"BBRHCJR", CHANNEL_CONTRACT_TEMPO_INDEX_RED_OK},    // Option Tempo, index rouge HC
+    {"BBRHCJW", CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_OK},  // Option Tempo, index blanc HC
+    {"BBRHPJB", CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_PK},   // Option Tempo, index bleu HP
+    {"BBRHPJR", CHANNEL_CONTRACT_TEMPO_INDEX_RED_PK},    // Option Tempo, index rouge HP
+    {"BBRHPJW", CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_PK},  // Option Tempo, index blanc HP
+    {"DEMAIN", CHANNEL_CONTRACT_TEMPO_TOMORROW},         // Option Tempo, couleur du lendemain
+    {"EAIT", CHANNEL_ENERGY_INJECTED_TOTAL},             // Energie active injectée totale
+    {"EASF01", CHANNEL_ENERGY_DELIVERED_INDEX_01},       // Energie active soutirée fournisseur, index 01
+    {"EASF02", CHANNEL_ENERGY_DELIVERED_INDEX_02},       // Energie active soutirée fournisseur, index 02
+    {"EASF03", CHANNEL_ENERGY_DELIVERED_INDEX_03},       // Energie active soutirée fournisseur, index 03
+    {"EASF04", CHANNEL_ENERGY_DELIVERED_INDEX_04},       // Energie active soutirée fournisseur, index 04
+    {"EASF05", CHANNEL_ENERGY_DELIVERED_INDEX_05},       // Energie active soutirée fournisseur, index 05
+    {"EASF06", CHANNEL_ENERGY_DELIVERED_INDEX_06},       // Energie active soutirée fournisseur, index 06
+    {"EASF07", CHANNEL_ENERGY_DELIVERED_INDEX_07},       // Energie active soutirée fournisseur, index 07
+    {"EASF08", CHANNEL_ENERGY_DELIVERED_INDEX_08},       // Energie active soutirée fournisseur, index 08
+    {"EASF09", CHANNEL_ENERGY_DELIVERED_INDEX_09},       // Energie active soutirée fournisseur, index 09
+    {"EASF10", CHANNEL_ENERGY_DELIVERED_INDEX_10},       // Energie active soutirée fournisseur, index 10
+    {"EAST", CHANNEL_ENERGY_DELIVERED_TOTAL},            // Energie active soutirée totale
+    {"EJPHN", CHANNEL_CONTRACT_EJP_INDEX_HN},            // Option EJP, index heures normales
+    {"EJPHPM", CHANNEL_CONTRACT_EJP_INDEX_HPM},          // Option EJP, index heures de pointe mobile
+    {"HCHC", CHANNEL_CONTRACT_HC_INDEX_HC},              // Option HC, index HC
+    {"HCHP", CHANNEL_CONTRACT_HC_INDEX_HP},              // Option HC, index HP
+    {"IINST", CHANNEL_PHASE_1_CURRENT},                  // Intensité instantanée
+    {"IINST1", CHANNEL_PHASE_1_CURRENT},                 // Intensité instantanée phase 1
+    {"IINST2", CHANNEL_PHASE_2_CURRENT},                 // Intensité instantanée phase 2
+    {"IINST3", CHANNEL_PHASE_3_CURRENT},                 // Intensité instantanée phase 3
+    {"IRMS1", CHANNEL_PHASE_1_CURRENT},                  // Courant efficace phase 1
+    {"IRMS2", CHANNEL_PHASE_2_CURRENT},                  // Courant efficace phase 2
+    {"IRMS3", CHANNEL_PHASE_3_CURRENT},                  // Courant efficace phase 3
+    {"ISOUSC", CHANNEL_CONTRACT_CURRENT},                // Intensité souscrite
+    {"LTARF", CHANNEL_CONTRACT_PERIOD},                  // Libellé tarif fournisseur en cours
+    {"NGTF", CHANNEL_CONTRACT_NAME},                     // Nom du calendrier tarifaire fournisseur
+    {"OPTARIF", CHANNEL_CONTRACT_NAME},                  // Option tarifaire choisie
+    {"PAPP", CHANNEL_POWER_APPARENT},                    // Puissance apparente
+    {"PEJP", CHANNEL_CONTRACT_EJP_NOTICE},               // Option EJP, préavis de début
+    {"PTEC", CHANNEL_CONTRACT_PERIOD},                   // Période tarifaire en cours
+    {"SINSTI", CHANNEL_POWER_APPARENT_INJECTED},         // Puissance apparente instantanée injectée
+    {"SINSTS", CHANNEL_POWER_APPARENT},                  // Puissance apparente instantanée soutirée
+    {"SINSTS1", CHANNEL_POWER_APPARENT_PHASE_1},         // Puissance apparente instantanée soutirée phase 1
+    {"SINSTS2", CHANNEL_POWER_APPARENT_PHASE_2},         // Puissance apparente instantanée soutirée phase 2
+    {"SINSTS3", CHANNEL_POWER_APPARENT_PHASE_3},         // Puissance apparente instantanée soutirée phase 3
+    {"SMAXSN", CHANNEL_POWER_APPARENT_MAX_PHASE_1},      // Puissance apparente max. soutirée du jour (horodatée)
+    {"SMAXSN1", CHANNEL_POWER_APPARENT_MAX_PHASE_1},     // Puissance apparente max. soutirée du jour phase 1 (horodatée)
+    {"SMAXSN2", CHANNEL_POWER_APPARENT_MAX_PHASE_2},     // Puissance apparente max. soutirée du jour phase 2 (horodatée)
+    {"SMAXSN3", CHANNEL_POWER_APPARENT_MAX_PHASE_3},     // Puissance apparente max. soutirée du jour phase 3 (horodatée)
+    {"STGE", CHANNEL_STATUS},                            // Registre de statuts
+    {"URMS1", CHANNEL_PHASE_1_VOLTAGE},                  // Tension efficace phase 1
+    {"URMS2", CHANNEL_PHASE_2_VOLTAGE},                  // Tension efficace phase 2
+    {"URMS3", CHANNEL_PHASE_3_VOLTAGE},                  // Tension efficace phase 3
+};
+#define LABEL_COUNT (sizeof(m_labels) / sizeof(m_labels[0]))
+static uint8_t m_frame_labels[(LABEL_COUNT + 7) / 8];  // Labels seen in the current frame
+
+/* Aggregates of instantaneous values, which are sent as a summary over a window rather than as they change
+ * Means of currents are sent with decimals, minimums and maximums saturate at 65535 */
+enum {
+    AGGREGATE_PHASE_1_CURRENT,
+    AGGREGATE_PHASE_1_VOLTAGE,
+    AGGREGATE_PHASE_2_CURRENT,
+    AGGREGATE_PHASE_2_VOLTAGE,
+    AGGREGATE_PHASE_3_CURRENT,
+    AGGREGATE_PHASE_3_VOLTAGE,
+    AGGREGATE_POWER_APPARENT,
+    AGGREGATE_POWER_APPARENT_PHASE_1,
+    AGGREGATE_POWER_APPARENT_PHASE_2,
+    AGGREGATE_POWER_APPARENT_PHASE_3,
+    AGGREGATE_POWER_APPARENT_INJECTED,
+    AGGREGATE_COUNT,
+};
+struct aggregate {
+    uint8_t channel;   // Channel aggregated, whose type is used for the mean
+    uint8_t type_min;  // Type used for the minimum
+    uint8_t type_max;  // Type used for the maximum
+};
+static const struct aggregate m_aggregates[AGGREGATE_COUNT] PROGMEM = {
+    {CHANNEL_PHASE_1_CURRENT, V_VAR1, V_VAR2},          // AGGREGATE_PHASE_1_CURRENT
+    {CHANNEL_PHASE_1_VOLTAGE, V_VAR3, V_VAR4},          // AGGREGATE_PHASE_1_VOLTAGE
+    {CHANNEL_PHASE_2_CURRENT, V_VAR1, V_VAR2},          // AGGREGATE_PHASE_2_CURRENT
+    {CHANNEL_PHASE_2_VOLTAGE, V_VAR3, V_VAR4},          // AGGREGATE_PHASE_2_VOLTAGE
+    {CHANNEL_PHASE_3_CURRENT, V_VAR1, V_VAR2},          // AGGREGATE_PHASE_3_CURRENT
+    {CHANNEL_PHASE_3_VOLTAGE, V_VAR3, V_VAR4},          // AGGREGATE_PHASE_3_VOLTAGE
+    {CHANNEL_POWER_APPARENT, V_VAR1, V_VAR2},           // AGGREGATE_POWER_APPARENT
+    {CHANNEL_POWER_APPARENT_PHASE_1, V_VAR1, V_VAR2},   // AGGREGATE_POWER_APPARENT_PHASE_1
+    {CHANNEL_POWER_APPARENT_PHASE_2, V_VAR1, V_VAR2},   // AGGREGATE_POWER_APPARENT_PHASE_2
+    {CHANNEL_POWER_APPARENT_PHASE_3, V_VAR1, V_VAR2},   // AGGREGATE_POWER_APPARENT_PHASE_3
+    {CHANNEL_POWER_APPARENT_INJECTED, V_VAR1, V_VAR2},  // AGGREGATE_POWER_APPARENT_INJECTED
+};
+static struct {
+    uint32_t sum;    // Sum of values received in the current window
+    uint16_t count;  // Number of values received in the current window
+    uint16_t min;    // Smallest value received in the current window
+    uint16_t max;    // Largest value received in the current window
+} m_aggregates_window[AGGREGATE_COUNT];
+static struct {
+    uint32_t mean;  // In thousandths
+    uint16_t min;
+    uint16_t max;
+} m_aggregates_summary[AGGREGATE_COUNT];                   // Summary of the last window, until it is sent
+static uint16_t m_aggregates_pending = 0;                  // Whether the summary of each aggregate needs to be sent, as a bit mask
+static uint8_t m_aggregates_cursor = AGGREGATE_COUNT * 3;  // Next part (mean, min or max) of a summary to send, or AGGREGATE_COUNT * 3 when done
+static uint32_t m_aggregates_timestamp = 0;                // When the current window started
+
+/* Active power, derived from the energy indexes
+ * Each time the energy increases, the time is remembered, and power is the energy between two such increases divided by the time between them.
+ * The window spans the most recent increases holding at least CONFIG_POWER_ENERGY_MIN_WH, so that it is short under heavy loads,
+ * and grows under light loads, where the index only increases every now and then */
+#define POWER_SAMPLE_COUNT 8
+static struct {
+    uint16_t indexes;  // Energy indexes summed, as a bit mask from CHANNEL_CONTRACT_BASE_INDEX
+    uint32_t energy;   // Sum of the last values of those indexes, in Wh
+    uint8_t count;     // Number of samples
+    uint8_t head;      // Most recent sample
+    bool estimated;    // Whether power has been estimated since the start
+    struct {
+        uint32_t timestamp;  // When the energy increased, in ms
+        uint32_t energy;     // Energy after that increase, in Wh
+    } samples[POWER_SAMPLE_COUNT];
+} m_power;
+
+/* Diagnostics, periodically sent to the controller to monitor the link with the meter and with the gateway
+ * Counters of the current period are reset once sent, the others are cumulative and wrap around */
+static struct {
+    uint16_t frames;                             // Frames received in the current period
+    uint16_t datasets;                           // Datasets received in the current period
+    uint16_t tic_errors;                         // Datasets rejected by the tic parser as malformed
+    uint16_t tic_checksum_errors;                // Datasets rejected by the tic parser because of a wrong checksum
+    uint16_t alert_overflows;                    // Characters lost by the tic port while an alert was being sent
+    uint16_t detections;                         // Baud rate detections started, the first one included
+    uint16_t sends_ok;                           // Messages sent in the current period
+    uint16_t sends_failed;                       // Messages not acknowledged by the next node in the current period
+    uint8_t sensors_sends_ok[SENSOR_COUNT];      // Messages sent per sensor in the current period, saturates at 255
+    uint8_t sensors_sends_failed[SENSOR_COUNT];  // Messages not acknowledged per sensor in the current period, saturates at 255
+    uint32_t frame_timestamp;                    // When the last frame ended, or 0 if none has yet
+} m_diagnostics;
+static bool m_gateway_lost = false;  // Whether the last message sent failed, in which case energy is sampled into the backlog
+
+/* Overload alerts, sent right away whatever the transmit budget, so that loads can be shed before the breaker trips
+ * An alert is sent when an overload starts or gets worse, then every now and then while it goes on, and once it is over */
+enum {
+    ALERT_LEVEL_NONE,
+    ALERT_LEVEL_CURRENT,   // Current close to the subscribed one
+    ALERT_LEVEL_OVERLOAD,  // Overload reported by the meter
+};
+static struct {
+    uint8_t level;       // Level of the last alert sent
+    uint8_t level_seen;  // Highest level seen in the current frame
+    bool sent;           // Whether an alert has been sent while processing the current dataset, for profiling
+    uint32_t timestamp;  // When the last alert was sent
+} m_alert;
+
+/* Transmit budget
+ * Messages are sent in bursts, each owned by the task sending it. Bursts are spaced out, and limited in number over a window,
+ * so that the supply has time to recover, and only start once the supply is high enough */
+enum {
+    TX_SOURCE_NONE,
+    TX_SOURCE_VALUES,       // High priority
+    TX_SOURCE_BACKLOG,      // Low priority
+    TX_SOURCE_DIAGNOSTICS,  // Low priority
 };
+static uint32_t m_tx_timestamp = 0;                 // When the last message was sent
+static uint8_t m_tx_burst_source = TX_SOURCE_NONE;  // Task owning the current burst
+static uint32_t m_tx_burst_timestamp = 0;           // When the last burst ended
+static uint32_t m_tx_window_timestamp = 0;          // When the current window started
+static uint8_t m_tx_window_bursts = 0;              // Bursts started in the current window
 
 /**
- * Setup function.
- * Called before MySensors does anything.
+ * Computes the checksum of settings, which covers everything but the checksum itself.
+ * @param[in] settings The settings.
+ * @return The checksum (CRC-8, polynomial 0x31).
  */
-void preHwInit(void) {
+static uint8_t settings_crc(const struct settings &settings) {
+    const uint8_t *bytes = (const uint8_t *)&settings;
+    uint8_t crc = 0xFF;
+    for (uint8_t i = 0; i < offsetof(struct settings, crc); i++) {
+        crc ^= bytes[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+    return crc;
+}
 
-    /* Setup leds
-     * Ensures tic link led is off at startup */
-    pinMode(CONFIG_LED_TIC_GREEN_PIN, OUTPUT);
-    pinMode(CONFIG_LED_TIC_RED_PIN, OUTPUT);
-    digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
-    digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
+/**
+ * Checks settings are within range, whether they come from eeprom or from the controller.
+ * @param[in] settings The settings to check.
+ * @return true if they can be used, false otherwise.
+ */
+static bool settings_check(const struct settings &settings) {
+    for (uint8_t i = 0; i < POLICY_COUNT; i++) {
+        const struct policy &policy = settings.policies[i];
+        if (policy.rule != pgm_read_byte(&m_settings_default.policies[i].rule)) {
+            return false;
+        }
+        if (policy.deadband_percent > 100) {
+            return false;
+        }
+        if (policy.interval_max_s != 0 && policy.interval_max_s < policy.interval_min_s) {
+            return false;
+        }
+    }
+    if (settings.policies_enabled >= (1 << POLICY_COUNT)) {
+        return false;
+    }
+    if (settings.log_level > LOG_LEVEL_DEBUG) {
+        return false;
+    }
+    if (settings.tx_gap_ms > SETTINGS_TX_GAP_MS_MAX) {
+        return false;
+    }
+    return true;
 }
 
 /**
- * Setup function.
- * Called once MySensors has successfully initialized.
+ * Loads settings from eeprom.
+ * @return 0 in case of success, or a negative error code if eeprom doesn't hold valid settings.
  */
-void setup(void) {
+static int settings_load(void) {
 
-    /* Setup serial port to computer */
-    Serial.begin(115200);
-    Serial.println(" [i] Hello world.");
+    /* Read settings */
+    struct settings settings;
+    uint8_t *bytes = (uint8_t *)&settings;
+    for (uint8_t i = 0; i < sizeof(struct settings); i++) {
+        bytes[i] = loadState(CONFIG_EEPROM_SETTINGS_ADDRESS + i);
+    }
+
+    /* Ensure they are valid */
+    if (settings.version != SETTINGS_VERSION || settings.crc != settings_crc(settings) || settings_check(settings) == false) {
+        return -EINVAL;
+    }
 
-    /* Setup tic reader */
-    m_tic_reader.setup(m_tic_port);
+    /* Use them */
+    m_settings = settings;
+    return 0;
+}
 
-    /* Return */
-    Serial.println(" [i] Setup done.");
+/**
+ * Saves settings to eeprom.
+ */
+static void settings_save(void) {
+    m_settings.crc = settings_crc(m_settings);
+    const uint8_t *bytes = (const uint8_t *)&m_settings;
+    for (uint8_t i = 0; i < sizeof(struct settings); i++) {
+        saveState(CONFIG_EEPROM_SETTINGS_ADDRESS + i, bytes[i]);
+    }
+}
+
+/**
+ * Restores default settings.
+ */
+static void settings_default(void) {
+    memcpy_P(&m_settings, &m_settings_default, sizeof(struct settings));
+}
+
+/**
+ * Loads the last baud rate at which datasets were received from eeprom.
+ * @return The baud rate, or 0 if eeprom doesn't hold a valid one.
+ */
+static uint16_t tic_baudrate_load(void) {
+    uint16_t baudrate = loadState(CONFIG_EEPROM_BAUDRATE_ADDRESS) | ((uint16_t)loadState(CONFIG_EEPROM_BAUDRATE_ADDRESS + 1) << 8);
+    return (baudrate == 1200 || baudrate == 9600) ? baudrate : 0;
+}
+
+/**
+ * Saves the baud rate at which datasets are received to eeprom.
+ * @param[in] baudrate The baud rate.
+ */
+static void tic_baudrate_save(uint16_t baudrate) {
+    saveState(CONFIG_EEPROM_BAUDRATE_ADDRESS, baudrate & 0xFF);
+    saveState(CONFIG_EEPROM_BAUDRATE_ADDRESS + 1, baudrate >> 8);
 }
 
 /**
  * MySensors function called to describe this sensor and its capabilites.
+ * Called at startup and whenever the controller asks for it.
  */
 void presentation(void) {
 
-    /* Because messages might be lost,
-     * we're not doing the presentation in one block, but rather step by step,
-     * making sure each step is sucessful before advancing to the next */
-    for (int8_t step = -1;;) {
-
-        /* Send out presentation information corresponding to the current step,
-         * and advance one step if successful */
-        switch (step) {
-            case -1: {
-                if (sendSketchInfo(F("SLHA00011 Linky"), F("1.3.0")) == true) {
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_0_SERIAL_NUMBER: {
-                if (present(SENSOR_0_SERIAL_NUMBER, S_INFO, F("Numéro de Série")) == true) {  // V_TEXT (ADCO, ADSC)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_1_MULTIMETER_PHASE_1: {
-                if (present(SENSOR_1_MULTIMETER_PHASE_1, S_MULTIMETER, F("Phase 1")) == true) {  // V_VOLTAGE (URMS1) and V_CURRENT (IINST, IINST1, IRMS1)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_2_MULTIMETER_PHASE_2: {
-                if (present(SENSOR_2_MULTIMETER_PHASE_2, S_MULTIMETER, F("Phase 2")) == true) {  // V_VOLTAGE (URMS2) and V_CURRENT (IINST2, IRMS2)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_3_MULTIMETER_PHASE_3: {
-                if (present(SENSOR_3_MULTIMETER_PHASE_3, S_MULTIMETER, F("Phase 3")) == true) {  // V_VOLTAGE (URMS3) and V_CURRENT (IINST3, IRMS3)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_4_POWER_APPARENT: {
-                if (present(SENSOR_4_POWER_APPARENT, S_POWER, F("Puissance Apparente")) == true) {  // V_WATT (PAPP)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_5_CONTRACT_NAME: {
-                if (present(SENSOR_5_CONTRACT_NAME, S_INFO, F("Option Tarifaire")) == true) {  // V_TEXT (OPTARIF)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_6_CONTRACT_CURRENT: {
-                if (present(SENSOR_6_CONTRACT_CURRENT, S_MULTIMETER, F("Intensité Souscrite")) == true) {  // V_CURRENT (ISOUSC)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_7_CONTRACT_PERIOD: {
-                if (present(SENSOR_7_CONTRACT_PERIOD, S_INFO, F("Période Tarifaire")) == true) {  // V_TEXT (PTEC)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_8_CONTRACT_BASE_INDEX: {
-                if (present(SENSOR_8_CONTRACT_BASE_INDEX, S_POWER, F("Index TH")) == true) {  // V_KWH (BASE)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_9_CONTRACT_HC_INDEX_HC: {
-                if (present(SENSOR_9_CONTRACT_HC_INDEX_HC, S_POWER, F("Index HC")) == true) {  // V_KWH (HCHC)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_10_CONTRACT_HC_INDEX_HP: {
-                if (present(SENSOR_10_CONTRACT_HC_INDEX_HP, S_POWER, F("Index HP")) == true) {  // V_KWH (HCHP)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_11_CONTRACT_EJP_INDEX_HN: {
-                if (present(SENSOR_11_CONTRACT_EJP_INDEX_HN, S_POWER, F("Index HN")) == true) {  // V_KWH (EJPHN)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_12_CONTRACT_EJP_INDEX_HPM: {
-                if (present(SENSOR_12_CONTRACT_EJP_INDEX_HPM, S_POWER, F("Index HPM")) == true) {  // V_KWH (EJPHPM)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_13_CONTRACT_EJP_NOTICE: {
-                if (present(SENSOR_13_CONTRACT_EJP_NOTICE, S_INFO, F("Préavis EJP")) == true) {  // V_TEXT (PEJP)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_15_CONTRACT_TEMPO_INDEX_BLUE_OK: {
-                if (present(SENSOR_15_CONTRACT_TEMPO_INDEX_BLUE_OK, S_POWER, F("Index Bleu HC")) == true) {  // V_KWH (BBRHCJB)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_14_CONTRACT_TEMPO_INDEX_BLUE_PK: {
-                if (present(SENSOR_14_CONTRACT_TEMPO_INDEX_BLUE_PK, S_POWER, F("Index Bleu HP")) == true) {  // V_KWH (BBRHPJB)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_17_CONTRACT_TEMPO_INDEX_WHITE_OK: {
-                if (present(SENSOR_17_CONTRACT_TEMPO_INDEX_WHITE_OK, S_POWER, F("Index Blanc HC")) == true) {  // V_KWH (BBRHCJW)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_16_CONTRACT_TEMPO_INDEX_WHITE_PK: {
-                if (present(SENSOR_16_CONTRACT_TEMPO_INDEX_WHITE_PK, S_POWER, F("Index Blanc HP")) == true) {  // V_KWH (BBRHPJW)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_19_CONTRACT_TEMPO_INDEX_RED_OK: {
-                if (present(SENSOR_19_CONTRACT_TEMPO_INDEX_RED_OK, S_POWER, F("Index Rouge HC")) == true) {  // V_KWH (BBRHCJR)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_18_CONTRACT_TEMPO_INDEX_RED_PK: {
-                if (present(SENSOR_18_CONTRACT_TEMPO_INDEX_RED_PK, S_POWER, F("Index Rouge HP")) == true) {  // V_KWH (BBRHPJR)
-                    step++;
-                }
-                break;
-            }
-            case SENSOR_20_CONTRACT_TEMPO_TOMORROW: {
-                if (present(SENSOR_20_CONTRACT_TEMPO_TOMORROW, S_INFO, F("Couleur Demain")) == true) {  // V_TEXT (DEMAIN)
-                    step++;
-                }
-                break;
-            }
-            default: {
-                return;
-            }
-        }
+    /* Presentation is done by its task, step by step, so that it never blocks tic reading,
+     * here we only (re)start it */
+    m_presentation_step = -1;
+}
 
-        /* Sleep a little bit after each presentation, otherwise the next fails
-         * @see https://forum.mysensors.org/topic/4450/sensor-presentation-failure */
-        sleep(50);
-    }
+/**
+ * Checks whether a sensor is used in the contract of the meter.
+ * @param[in] sensor The sensor.
+ * @return true if it is, or if the contract isn't known yet, false otherwise.
+ */
+static bool sensor_used(uint8_t sensor) {
+    return (m_contract == CONTRACT_UNKNOWN || (pgm_read_byte(&m_sensors[sensor].contracts) & (1 << m_contract)) != 0);
 }
 
 /**
- * MySensors function called when a message is received.
+ * Learns the contract of the meter from its name, and remembers it in eeprom.
+ * If it changes from a known one, sensors are presented again, as other ones are now used.
+ * @param[in] name The dataset label, OPTARIF or NGTF.
+ * @param[in] data The contract name, without padding.
  */
-void receive(const MyMessage &message) {
+static void contract_update(const char *name, const char *data) {
 
-    /* For now we ignore the received message */
-    (void)message;
+    /* Standard mode indexes don't depend on the calendar, historic mode ones are named after the option */
+    uint8_t contract;
+    if (strcmp_P(name, PSTR("NGTF")) == 0) {
+        contract = CONTRACT_STANDARD;
+    } else if (strcmp_P(data, PSTR("BASE")) == 0) {
+        contract = CONTRACT_BASE;
+    } else if (strcmp_P(data, PSTR("HC")) == 0) {
+        contract = CONTRACT_HC;
+    } else if (strcmp_P(data, PSTR("EJP")) == 0) {
+        contract = CONTRACT_EJP;
+    } else if (strncmp_P(data, PSTR("BBR"), 3) == 0) {
+        contract = CONTRACT_TEMPO;
+    } else {
+        return;
+    }
+    if (contract == m_contract) {
+        return;
+    }
+
+    /* Remember it */
+    LOG_I(MAIN, "Contract changed from %u to %u.", m_contract, contract);
+    saveState(CONFIG_EEPROM_CONTRACT_ADDRESS, contract);
+    bool known = (m_contract != CONTRACT_UNKNOWN);
+    m_contract = contract;
+    if (known == true) {
+        presentation();
+    }
 }
 
 /**
- * Main loop.
+ * @param[in] channel_index The channel.
+ * @return The priority of the channel, one of PRIORITY_*.
  */
-void loop(void) {
-    int res;
+static uint8_t channel_priority(uint8_t channel_index) {
+    uint8_t policy = pgm_read_byte(&m_channels[channel_index].policy);
+    if (policy == POLICY_STATE) {
+        return PRIORITY_HIGH;
+    } else if (policy == POLICY_INDEX) {
+        return PRIORITY_LOW;
+    } else {
+        return PRIORITY_MEDIUM;
+    }
+}
 
-    /* Led task */
-    {
-        static uint32_t m_led_timestamp = 0;
-        static enum {
-            STATE_0,
-            STATE_1,
-            STATE_2,
-            STATE_3,
-            STATE_4,
-            STATE_5,
-            STATE_6,
-            STATE_7,
-            STATE_8,
-            STATE_9,
-        } m_led_sm;
-        switch (m_led_sm) {
-            case STATE_0: {
-                if (m_tic_state == STATE_STARTING) {
-                    m_led_sm = STATE_1;
-                } else if (m_tic_state == STATE_VALID) {
-                    m_led_sm = STATE_4;
-                } else {
-                    m_led_sm = STATE_7;
-                }
-                break;
-            }
-            case STATE_1: {
-                digitalWrite(CONFIG_LED_TIC_RED_PIN, HIGH);
-                digitalWrite(CONFIG_LED_TIC_GREEN_PIN, HIGH);
-                m_led_timestamp = millis();
-                m_led_sm = STATE_2;
-                break;
-            }
-            case STATE_2: {
-                if (millis() - m_led_timestamp >= 100) {
-                    digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
-                    digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
-                    m_led_sm = STATE_3;
-                }
-                break;
-            }
-            case STATE_3: {
-                if (millis() - m_led_timestamp >= 1000) {
-                    m_led_sm = STATE_0;
-                }
-                break;
-            }
-            case STATE_4: {
-                digitalWrite(CONFIG_LED_TIC_GREEN_PIN, HIGH);
-                digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
-                m_led_timestamp = millis();
-                m_led_sm = STATE_5;
-                break;
-            }
-            case STATE_5: {
-                if (millis() - m_led_timestamp >= 100) {
-                    digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
-                    digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
-                    m_led_sm = STATE_6;
-                }
-                break;
-            }
-            case STATE_6: {
-                if (millis() - m_led_timestamp >= 10000) {
-                    m_led_sm = STATE_0;
-                }
-                break;
-            }
-            case STATE_7: {
-                digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
-                digitalWrite(CONFIG_LED_TIC_RED_PIN, HIGH);
-                m_led_timestamp = millis();
-                m_led_sm = STATE_8;
-                break;
-            }
-            case STATE_8: {
-                if (millis() - m_led_timestamp >= 100) {
-                    digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
-                    digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
-                    m_led_sm = STATE_9;
-                }
-                break;
-            }
-            case STATE_9: {
-                if (millis() - m_led_timestamp >= 1000) {
-                    m_led_sm = STATE_0;
-                }
-                break;
+/**
+ * Finds the next channel to send, the one of highest priority among those that need to be sent, in channel order for a same priority.
+ * Each channel holds the last value received, so values received again before being sent are coalesced.
+ * Channels which failed to be sent in the current burst are left for the next one.
+ * @return The channel, or CHANNEL_COUNT if none needs to be sent.
+ */
+static uint8_t channel_next(void) {
+    uint8_t next = CHANNEL_COUNT;
+    uint8_t next_priority = PRIORITY_COUNT;
+    for (uint8_t i = 0; i < CHANNEL_COUNT && next_priority != PRIORITY_HIGH; i++) {
+        if ((m_channels_state[i].flags & (CHANNEL_FLAG_DIRTY | CHANNEL_FLAG_SKIPPED)) == CHANNEL_FLAG_DIRTY) {
+            uint8_t priority = channel_priority(i);
+            if (priority < next_priority) {
+                next = i;
+                next_priority = priority;
             }
         }
     }
+    return next;
+}
 
-    /* Tic reading task */
-    {
-        static enum {
-            STATE_0,
-            STATE_1,
-        } m_tic_sm;
-        switch (m_tic_sm) {
-
-            case STATE_0: {
-
-                /* Automatically detect baud rate at which linky meter sends the data, as it can use:
-                 * - either 1200 for historic (most common),
-                 * - or 9600 for standard (required when producing elecriticity) */
-                m_tic_port.end();
-                pinMode(CONFIG_TIC_DATA_PIN, INPUT);
-                uint32_t period_us_min = UINT32_MAX;
-                for (uint8_t i = 0; i < 10; i++) {
-
-                    /* Wait for pin to be high (uart idle state) */
-                    while (digitalRead(CONFIG_TIC_DATA_PIN) == 1) {
-                    }
-
-                    /* Once it is high, measure the amount of time it goes low */
-                    uint32_t period_us = pulseIn(CONFIG_TIC_DATA_PIN, LOW);
-                    if (period_us < period_us_min) {
-                        period_us_min = period_us;
-                    }
-                }
+/**
+ * Checks whether the value received on a channel needs to be sent, according to its reporting policy.
+ * @param[in] channel_index The channel.
+ * @param[in] now_s The current time, in seconds since startup.
+ * @return true if the value needs to be sent, false otherwise.
+ */
+static bool channel_policy_check(uint8_t channel_index, uint16_t now_s) {
 
-                /* Convert minimal period to frequency */
-                if (period_us_min >= 666 && period_us_min <= 1000) {
-                    Serial.println(" [i] Detected baudrate of 1200");
-                    m_tic_port_baudrate = 1200;
-                    m_tic_port.begin(m_tic_port_baudrate);
-                    m_tic_sm = STATE_1;
-                } else if (period_us_min >= 83 && period_us_min <= 125) {
-                    Serial.println(" [i] Detected baudrate of 9600");
-                    m_tic_port_baudrate = 9600;
-                    m_tic_port.begin(m_tic_port_baudrate);
-                    m_tic_sm = STATE_1;
-                } else {
-                    Serial.println(" [e] Failed to detect baudrate!");
-                    m_tic_state = STATE_INVALID;
-                }
-                break;
-            }
+    /* Retrieve policy */
+    struct policy policy;
+    if ((m_settings.policies_enabled & (1 << pgm_read_byte(&m_channels[channel_index].policy))) == 0) {
+        return false;
+    }
+    memcpy(&policy, &m_settings.policies[pgm_read_byte(&m_channels[channel_index].policy)], sizeof(struct policy));
+    uint32_t value = m_channels_state[channel_index].value;
+    uint32_t value_sent = m_channels_state[channel_index].sent;
+    uint16_t elapsed_s = now_s - m_channels_state[channel_index].sent_s;
 
-            case STATE_1: {
+    /* Send first value right away */
+    if ((m_channels_state[channel_index].flags & CHANNEL_FLAG_REPORTED) == 0) {
+        return true;
+    }
 
-                /* Read incoming datasets */
-                struct tic_dataset dataset = {0};
-                res = m_tic_reader.read(dataset);
-                if (res < 0) {
-                    Serial.println(" [e] Tic error!");
-                    m_tic_state = STATE_INVALID;
-                    m_tic_sm = STATE_0;
-                    break;
-                } else if (res == 0) {
-                    break;
-                }
+    /* Send again unchanged values once in a while, in case the controller missed them */
+    if (policy.interval_max_s != 0 && elapsed_s >= policy.interval_max_s) {
+        return true;
+    }
 
-                Serial.printf(" [d] Received dataset %s = %s\r\n", dataset.name, dataset.data);
-                m_tic_state = STATE_VALID;
-
-                /* Numéro de Série */
-                if (strcmp_P(dataset.name, PSTR("ADCO")) == 0 ||  //
-                    strcmp_P(dataset.name, PSTR("ADSC")) == 0) {
-                    static char value_last[12 + 1];
-                    if (strcmp(dataset.data, value_last) != 0) {
-                        MyMessage message(SENSOR_0_SERIAL_NUMBER, V_TEXT);
-                        if (send(message.set(dataset.data)) == true) {
-                            strncpy(value_last, dataset.data, 12);
-                        }
-                    }
-                }
+    /* Otherwise, don't send values too often */
+    if (elapsed_s < policy.interval_min_s) {
+        return false;
+    }
 
-                /* Intensité Phase 1 */
-                else if (strcmp_P(dataset.name, PSTR("IINST")) == 0 ||   //
-                         strcmp_P(dataset.name, PSTR("IINST1")) == 0 ||  //
-                         strcmp_P(dataset.name, PSTR("IRMS1")) == 0) {
-                    static uint8_t value_last = 0;
-                    uint8_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_1_MULTIMETER_PHASE_1, V_CURRENT);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* And only when they have changed enough */
+    uint32_t deadband = (value_sent / 100) * policy.deadband_percent;
+    if (deadband < policy.deadband) {
+        deadband = policy.deadband;
+    }
+    if (policy.rule == RULE_INCREASED) {
+        return (value > value_sent && value - value_sent > deadband);
+    } else if (value > value_sent) {
+        return (value - value_sent > deadband);
+    } else {
+        return (value_sent - value > deadband);
+    }
+}
 
-                /* Tension Phase 1 */
-                else if (strcmp_P(dataset.name, PSTR("URMS1")) == 0) {
-                    static uint16_t value_last = 0;
-                    uint16_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_1_MULTIMETER_PHASE_1, V_VOLTAGE);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+/**
+ * Sums the delivered energy indexes of the contract, as only the one of the current tariff period increases.
+ * These are the historic mode indexes, and the standard mode total. Each one is taken as last received,
+ * so that a frame which misses one, because of a checksum error for instance, doesn't change the sum.
+ * @param[out] energy The sum, in Wh.
+ * @return The indexes summed, as a bit mask from CHANNEL_CONTRACT_BASE_INDEX, or 0 if the contract isn't known,
+ * or if one of its indexes has never been received, in which case the sum would fall short.
+ */
+static uint16_t energy_sum(uint32_t &energy) {
+    energy = 0;
+    if (m_contract == CONTRACT_UNKNOWN) {
+        return 0;
+    }
+    uint16_t indexes = 0;
+    for (uint8_t i = CHANNEL_CONTRACT_BASE_INDEX; i <= CHANNEL_ENERGY_DELIVERED_TOTAL; i++) {
+        if (pgm_read_byte(&m_channels[i].kind) != KIND_KWH || sensor_used(pgm_read_byte(&m_channels[i].sensor)) == false) {
+            continue;
+        }
+        if ((m_channels_state[i].flags & CHANNEL_FLAG_KNOWN) == 0) {
+            return 0;
+        }
+        energy += m_channels_state[i].value;
+        indexes |= (1 << (i - CHANNEL_CONTRACT_BASE_INDEX));
+    }
+    return indexes;
+}
 
-                /* Intensité Phase 2 */
-                else if (strcmp_P(dataset.name, PSTR("IINST2")) == 0 ||  //
-                         strcmp_P(dataset.name, PSTR("IRMS2")) == 0) {
-                    static uint8_t value_last = 0;
-                    uint8_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_2_MULTIMETER_PHASE_2, V_CURRENT);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+/**
+ * Updates the active power from the energy indexes received during a frame.
+ * @param[in] now_ms The time at which the frame ended, in ms.
+ */
+static void power_update(uint32_t now_ms) {
 
-                /* Tension Phase 2 */
-                else if (strcmp_P(dataset.name, PSTR("URMS2")) == 0) {
-                    static uint16_t value_last = 0;
-                    uint16_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_2_MULTIMETER_PHASE_2, V_VOLTAGE);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* Only frames which carried an index tell something new */
+    bool received = false;
+    for (uint8_t i = CHANNEL_CONTRACT_BASE_INDEX; i <= CHANNEL_ENERGY_DELIVERED_TOTAL; i++) {
+        if (pgm_read_byte(&m_channels[i].kind) == KIND_KWH && (m_channels_state[i].flags & CHANNEL_FLAG_RECEIVED)) {
+            received = true;
+        }
+    }
+    uint32_t energy;
+    uint16_t indexes = energy_sum(energy);
+    if (received == false || indexes == 0) {
+        return;
+    }
 
-                /* Intensité Phase 3 */
-                else if (strcmp_P(dataset.name, PSTR("IINST3")) == 0 ||  //
-                         strcmp_P(dataset.name, PSTR("IRMS3")) == 0) {
-                    static uint8_t value_last = 0;
-                    uint8_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_3_MULTIMETER_PHASE_3, V_CURRENT);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* Start over if the indexes summed changed, which is when the contract does, or if energy decreased, as values can't be compared anymore */
+    if (indexes != m_power.indexes || energy < m_power.energy) {
+        m_power.indexes = indexes;
+        m_power.energy = energy;
+        m_power.count = 0;
+        m_power.estimated = false;
+        return;
+    }
 
-                /* Tension Phase 3 */
-                else if (strcmp_P(dataset.name, PSTR("URMS3")) == 0) {
-                    static uint16_t value_last = 0;
-                    uint16_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_3_MULTIMETER_PHASE_3, V_VOLTAGE);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* Remember when energy increases
+     * The first value received is not one of those, as it increased some unknown time before */
+    if (energy > m_power.energy) {
+        m_power.head = (m_power.head + 1) % POWER_SAMPLE_COUNT;
+        m_power.samples[m_power.head].timestamp = now_ms;
+        m_power.samples[m_power.head].energy = energy;
+        if (m_power.count < POWER_SAMPLE_COUNT) {
+            m_power.count++;
+        }
+        m_power.energy = energy;
+    }
 
-                /* Puissance apparente */
-                else if (strcmp_P(dataset.name, PSTR("PAPP")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_4_POWER_APPARENT, V_WATT);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* Forget increases too old to give a relevant power */
+    while (m_power.count > 0) {
+        uint8_t oldest = (m_power.head + POWER_SAMPLE_COUNT + 1 - m_power.count) % POWER_SAMPLE_COUNT;
+        if (now_ms - m_power.samples[oldest].timestamp <= CONFIG_POWER_WINDOW_MAX_S * 1000UL) {
+            break;
+        }
+        m_power.count--;
+    }
 
-                /* Option tarifaire choisie */
-                else if (strcmp_P(dataset.name, PSTR("OPTARIF")) == 0) {
-                    for (uint8_t i = 0; i < 4; i++) {
-                        if (dataset.data[i] == '.') {
-                            dataset.data[i] = '\0';
-                            break;
-                        }
-                    }
-                    static char value_last[4 + 1];
-                    if (strcmp(dataset.data, value_last) != 0) {
-                        MyMessage message(SENSOR_5_CONTRACT_NAME, V_TEXT);
-                        if (send(message.set(dataset.data)) == true) {
-                            strncpy(value_last, dataset.data, 4);
-                        }
-                    }
-                }
+    /* Go back in time from the last increase until enough energy is covered, or the oldest increase is reached */
+    uint8_t newest = m_power.head;
+    uint32_t power = m_channels_state[CHANNEL_POWER_ACTIVE].value;
+    if (m_power.count >= 2) {
+        uint8_t reference = newest;
+        for (uint8_t i = 1; i < m_power.count; i++) {
+            reference = (newest + POWER_SAMPLE_COUNT - i) % POWER_SAMPLE_COUNT;
+            if (m_power.samples[newest].energy - m_power.samples[reference].energy >= CONFIG_POWER_ENERGY_MIN_WH) {
+                break;
+            }
+        }
+        uint32_t energy_wh = m_power.samples[newest].energy - m_power.samples[reference].energy;
+        uint32_t duration_ms = m_power.samples[newest].timestamp - m_power.samples[reference].timestamp;
+        if (duration_ms > 0) {
+            if (energy_wh <= UINT32_MAX / 3600000UL) {
+                power = energy_wh * 3600000UL / duration_ms;
+            } else {
+                power = energy_wh * 3600UL / (duration_ms / 1000 + 1);
+            }
+            m_power.estimated = true;
+        }
+    }
+    if (m_power.estimated == false) {
+        return;
+    }
 
-                /* Intensité Souscrite */
-                else if (strcmp_P(dataset.name, PSTR("ISOUSC")) == 0) {
-                    static uint8_t value_last = 0;
-                    uint8_t value = strtoul(dataset.data, NULL, 10);
-                    if (value != value_last) {
-                        MyMessage message(SENSOR_6_CONTRACT_CURRENT, V_CURRENT);
-                        if (send(message.set(value)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* If energy hasn't increased for a while, power is at most 1 Wh over the time elapsed since the last increase,
+     * and without any increase in the whole window, it rounds to 0 */
+    if (m_power.count == 0) {
+        power = 0;
+    } else {
+        uint32_t elapsed_ms = now_ms - m_power.samples[newest].timestamp;
+        if (elapsed_ms > 0 && power > 3600000UL / elapsed_ms) {
+            power = 3600000UL / elapsed_ms;
+        }
+    }
 
-                /* Période tarifaire en cours */
-                else if (strcmp_P(dataset.name, PSTR("PTEC")) == 0) {
-                    for (uint8_t i = 0; i < 4; i++) {
-                        if (dataset.data[i] == '.') {
-                            dataset.data[i] = '\0';
-                            break;
-                        }
-                    }
-                    static char value_last[4 + 1];
-                    if (strcmp(dataset.data, value_last) != 0) {
-                        MyMessage message(SENSOR_7_CONTRACT_PERIOD, V_TEXT);
-                        if (send(message.set(dataset.data)) == true) {
-                            strncpy(value_last, dataset.data, 4);
-                        }
-                    }
-                }
+    /* Feed channel, as if the value had been received */
+    m_channels_state[CHANNEL_POWER_ACTIVE].value = power;
+    m_channels_state[CHANNEL_POWER_ACTIVE].flags |= CHANNEL_FLAG_RECEIVED;
+}
 
-                /* Option Base, index TH */
-                else if (strcmp_P(dataset.name, PSTR("BASE")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_8_CONTRACT_BASE_INDEX, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+/**
+ * Checks whether a channel is only sent as summaries, instead of according to its reporting policy.
+ * @param[in] channel_index The channel.
+ * @return true if the channel is aggregated, false otherwise.
+ */
+static bool channel_aggregated(uint8_t channel_index) {
+    for (uint8_t i = 0; CONFIG_AGGREGATE_WINDOW_S > 0 && i < AGGREGATE_COUNT; i++) {
+        if (pgm_read_byte(&m_aggregates[i].channel) == channel_index) {
+            return true;
+        }
+    }
+    return false;
+}
 
-                /* Option HC, index HC */
-                else if (strcmp_P(dataset.name, PSTR("HCHC")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_9_CONTRACT_HC_INDEX_HC, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+/**
+ * Checks whether all channels of a reporting policy are aggregated, in which case its intervals and deadbands have no use.
+ * @param[in] policy The reporting policy.
+ * @return true if all its channels are aggregated, false otherwise.
+ */
+static bool policy_aggregated(uint8_t policy) {
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        if (pgm_read_byte(&m_channels[i].policy) == policy && channel_aggregated(i) == false) {
+            return false;
+        }
+    }
+    return true;
+}
 
-                /* Option HC, index HP */
-                else if (strcmp_P(dataset.name, PSTR("HCHP")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_10_CONTRACT_HC_INDEX_HP, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+/**
+ * Checks whether the summary of an aggregate needs to be sent, which isn't the case anymore once its reporting policy is disabled.
+ * @param[in] aggregate_index The aggregate.
+ * @return true if the summary needs to be sent, false otherwise.
+ */
+static bool aggregate_pending(uint8_t aggregate_index) {
+    uint8_t policy = pgm_read_byte(&m_channels[pgm_read_byte(&m_aggregates[aggregate_index].channel)].policy);
+    return (m_aggregates_pending & (1 << aggregate_index)) && (m_settings.policies_enabled & (1 << policy));
+}
 
-                /* Option EJP, index heures normales */
-                else if (strcmp_P(dataset.name, PSTR("EJPHN")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_11_CONTRACT_EJP_INDEX_HN, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+/**
+ * Adds the instantaneous values received during a frame to their aggregates,
+ * and once the window is over, turns those into summaries that need to be sent.
+ * @param[in] now_ms The time at which the frame ended, in ms.
+ */
+static void aggregates_update(uint32_t now_ms) {
 
-                /* Option EJP, index heures de pointe mobile */
-                else if (strcmp_P(dataset.name, PSTR("EJPHPM")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_12_CONTRACT_EJP_INDEX_HPM, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* Add values received, unless their reporting policy is disabled */
+    for (uint8_t i = 0; i < AGGREGATE_COUNT; i++) {
+        uint8_t channel_index = pgm_read_byte(&m_aggregates[i].channel);
+        bool enabled = (m_settings.policies_enabled & (1 << pgm_read_byte(&m_channels[channel_index].policy)));
+        if (enabled == true && (m_channels_state[channel_index].flags & CHANNEL_FLAG_RECEIVED)) {
+            uint32_t value = m_channels_state[channel_index].value;
+            uint16_t value_saturated = (value > UINT16_MAX) ? UINT16_MAX : value;
+            if (m_aggregates_window[i].count == 0 || value_saturated < m_aggregates_window[i].min) {
+                m_aggregates_window[i].min = value_saturated;
+            }
+            if (m_aggregates_window[i].count == 0 || value_saturated > m_aggregates_window[i].max) {
+                m_aggregates_window[i].max = value_saturated;
+            }
+            m_aggregates_window[i].sum += value;
+            if (m_aggregates_window[i].count < UINT16_MAX) {
+                m_aggregates_window[i].count++;
+            }
+        }
+    }
 
-                /* Option EJP, préavis de début */
-                else if (strcmp_P(dataset.name, PSTR("PEJP")) == 0) {
-                    static char value_last[2 + 1];
-                    if (strcmp(dataset.data, value_last) != 0) {
-                        MyMessage message(SENSOR_13_CONTRACT_EJP_NOTICE, V_TEXT);
-                        if (send(message.set(dataset.data)) == true) {
-                            strncpy(value_last, dataset.data, 2);
-                        }
-                    }
-                }
+    /* Summarize window once it is over, and start a new one */
+    if (now_ms - m_aggregates_timestamp < CONFIG_AGGREGATE_WINDOW_S * 1000UL) {
+        return;
+    }
+    m_aggregates_timestamp = now_ms;
+    for (uint8_t i = 0; i < AGGREGATE_COUNT; i++) {
+        uint8_t policy = pgm_read_byte(&m_channels[pgm_read_byte(&m_aggregates[i].channel)].policy);
+        if ((m_settings.policies_enabled & (1 << policy)) == 0) {
+            m_aggregates_pending &= ~(1 << i);
+        } else if (m_aggregates_window[i].count > 0) {
+            uint32_t sum = m_aggregates_window[i].sum;
+            uint16_t count = m_aggregates_window[i].count;
+            m_aggregates_summary[i].mean = (sum <= UINT32_MAX / 1000) ? (sum * 1000 / count) : (sum / count * 1000);
+            m_aggregates_summary[i].min = m_aggregates_window[i].min;
+            m_aggregates_summary[i].max = m_aggregates_window[i].max;
+            m_aggregates_pending |= (1 << i);
+        }
+    }
+    memset(m_aggregates_window, 0, sizeof(m_aggregates_window));
 
-                /* Option Tempo, index bleu HC */
-                else if (strcmp_P(dataset.name, PSTR("BBRHCJB")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_15_CONTRACT_TEMPO_INDEX_BLUE_OK, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+    /* Start sending */
+    if (m_aggregates_cursor >= AGGREGATE_COUNT * 3) {
+        m_aggregates_cursor = 0;
+    }
+}
 
-                /* Option Tempo, index bleu HP */
-                else if (strcmp_P(dataset.name, PSTR("BBRHPJB")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_14_CONTRACT_TEMPO_INDEX_BLUE_PK, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
-                }
+/**
+ * Checks whether a task can send a message now, according to the transmit budget.
+ * If it doesn't own the current burst, a new one is started if possible.
+ * High priority tasks take over bursts of low priority ones, which then have to wait for a new one.
+ * @param[in] source The task, one of TX_SOURCE_*.
+ * @return true if the task can send a message, false if it has to wait.
+ */
+static bool tx_ready(uint8_t source) {
 
-                /* Option Tempo, index blanc HC */
-                else if (strcmp_P(dataset.name, PSTR("BBRHCJW")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_17_CONTRACT_TEMPO_INDEX_WHITE_OK, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
+    /* Space out messages, and wait for the supply to be high enough, higher still for low priority messages */
+    if (millis() - m_tx_timestamp < m_settings.tx_gap_ms) {
+        return false;
+    }
+    uint16_t supply_mv = m_supply.millivolts();
+    if (supply_mv < CONFIG_SUPPLY_MIN_MV || (source != TX_SOURCE_VALUES && supply_mv < CONFIG_SUPPLY_RECOVERED_MV)) {
+        return false;
+    }
+
+    /* Carry on with the current burst */
+    if (m_tx_burst_source == source) {
+        return true;
+    } else if (m_tx_burst_source != TX_SOURCE_NONE) {
+        if (source == TX_SOURCE_VALUES) {
+            m_tx_burst_source = source;
+            return true;
+        }
+        return false;
+    }
+
+    /* Start a new burst if allowed */
+    if (millis() - m_tx_window_timestamp >= CONFIG_TX_WINDOW_S * 1000UL) {
+        m_tx_window_timestamp = millis();
+        m_tx_window_bursts = 0;
+    }
+    if (millis() - m_tx_burst_timestamp < CONFIG_TX_BURST_GAP_MS || m_tx_window_bursts >= CONFIG_TX_WINDOW_BURSTS_MAX) {
+        return false;
+    }
+    m_tx_window_bursts++;
+    m_tx_burst_source = source;
+    return true;
+}
+
+/**
+ * Ends the burst of a task, if it owns it, once it has nothing more to send.
+ * @param[in] source The task, one of TX_SOURCE_*.
+ */
+static void tx_done(uint8_t source) {
+    if (m_tx_burst_source == source) {
+        m_tx_burst_source = TX_SOURCE_NONE;
+        m_tx_burst_timestamp = millis();
+    }
+}
+
+/**
+ * Sends a message to the controller, and accounts for it in diagnostics.
+ * @param[in] message The message.
+ * @return true if the message has been acknowledged by the next node, false otherwise.
+ */
+static bool message_send(MyMessage &message) {
+    uint8_t sensor = message.getSensor();
+    PROFILE_START(send);
+    bool success = send(message);
+    PROFILE_STOP(send, PROFILE_PROBE_SEND, sensor);
+    m_tx_timestamp = millis();
+    m_gateway_lost = !success;
+    if (success == true) {
+        m_diagnostics.sends_ok++;
+        if (m_diagnostics.sensors_sends_ok[sensor] < UINT8_MAX) {
+            m_diagnostics.sensors_sends_ok[sensor]++;
+        }
+    } else {
+        m_diagnostics.sends_failed++;
+        if (m_diagnostics.sensors_sends_failed[sensor] < UINT8_MAX) {
+            m_diagnostics.sensors_sends_failed[sensor]++;
+        }
+    }
+    return success;
+}
+
+/**
+ * MySensors function called when a message is received.
+ * The configuration sensor accepts the following commands:
+ * - V_VAR1 "<policy>:<min>:<max>" sets the minimum and maximum intervals of a reporting policy, in s,
+ * - V_VAR2 "<policy>:<absolute>:<percent>" sets the deadbands of a reporting policy,
+ *   both being refused for policies whose values are all aggregated, as summaries are sent at the end of each window instead,
+ * - V_VAR3 "<level>" sets the log level, from 0 (none) to 4 (debug),
+ * - V_VAR4 "<mask>" sets which reporting policies have their values sent, as a bit mask,
+ * - V_VAR5 "<gap>" sets the time between two messages of a burst, in ms,
+ * - V_CUSTOM "defaults" restores the default settings.
+ * Settings are saved in eeprom, and the resulting setting is sent back.
+ */
+void receive(const MyMessage &message) {
+
+    /* Ignore messages not meant for the configuration sensor */
+    if (message.getCommand() != C_SET || message.isEcho() == true || message.getSensor() != SENSOR_41_CONFIGURATION) {
+        return;
+    }
+
+    /* Parse up to three numbers */
+    char buffer[MAX_PAYLOAD_SIZE + 1];
+    message.getString(buffer);
+    uint32_t args[3] = {0};
+    uint8_t args_count = 0;
+    for (char *c = buffer; args_count < 3;) {
+        char *end;
+        args[args_count] = strtoul(c, &end, 10);
+        if (end == c) {
+            break;
+        }
+        args_count++;
+        if (*end != ':') {
+            break;
+        }
+        c = end + 1;
+    }
+
+    /* Apply setting, and prepare resulting setting */
+    struct settings settings = m_settings;
+    uint32_t results[3];
+    uint8_t results_count = 0;
+    int res = 0;
+    switch (message.getType()) {
+        case V_VAR1: {
+            if (args_count != 3 || args[0] >= POLICY_COUNT || policy_aggregated(args[0]) == true || args[1] > UINT16_MAX || args[2] > UINT16_MAX) {
+                res = -EINVAL;
+                break;
+            }
+            settings.policies[args[0]].interval_min_s = args[1];
+            settings.policies[args[0]].interval_max_s = args[2];
+            results[results_count++] = args[0];
+            results[results_count++] = settings.policies[args[0]].interval_min_s;
+            results[results_count++] = settings.policies[args[0]].interval_max_s;
+            break;
+        }
+        case V_VAR2: {
+            if (args_count != 3 || args[0] >= POLICY_COUNT || policy_aggregated(args[0]) == true || args[1] > UINT16_MAX || args[2] > UINT8_MAX) {
+                res = -EINVAL;
+                break;
+            }
+            settings.policies[args[0]].deadband = args[1];
+            settings.policies[args[0]].deadband_percent = args[2];
+            results[results_count++] = args[0];
+            results[results_count++] = settings.policies[args[0]].deadband;
+            results[results_count++] = settings.policies[args[0]].deadband_percent;
+            break;
+        }
+        case V_VAR3: {
+            if (args_count != 1 || args[0] > UINT8_MAX) {
+                res = -EINVAL;
+                break;
+            }
+            settings.log_level = args[0];
+            results[results_count++] = settings.log_level;
+            break;
+        }
+        case V_VAR4: {
+            if (args_count != 1 || args[0] > UINT8_MAX) {
+                res = -EINVAL;
+                break;
+            }
+            settings.policies_enabled = args[0];
+            results[results_count++] = settings.policies_enabled;
+            break;
+        }
+        case V_VAR5: {
+            if (args_count != 1 || args[0] > UINT16_MAX) {
+                res = -EINVAL;
+                break;
+            }
+            settings.tx_gap_ms = args[0];
+            results[results_count++] = settings.tx_gap_ms;
+            break;
+        }
+        case V_CUSTOM: {
+            if (strcmp_P(buffer, PSTR("defaults")) != 0) {
+                res = -EINVAL;
+                break;
+            }
+            memcpy_P(&settings, &m_settings_default, sizeof(struct settings));
+            break;
+        }
+        default: {
+            return;
+        }
+    }
+
+    /* Ensure resulting settings are valid as a whole, then use them */
+    if (res == 0 && settings_check(settings) == false) {
+        res = -EINVAL;
+    }
+    if (res < 0) {
+        LOG_E(MAIN, "Invalid setting!");
+        strcpy_P(buffer, PSTR("error"));
+    } else {
+        m_settings = settings;
+        settings_save();
+        log_level_set(m_settings.log_level);
+        if (results_count > 0) {
+            format_list(buffer, results, results_count);
+        }
+    }
+
+    /* Send back resulting setting */
+    MyMessage reply(SENSOR_41_CONFIGURATION, message.getType());
+    message_send(reply.set(buffer));
+}
+
+/**
+ * Sends an alert to the controller, right away, retrying a few times on failure.
+ * The transmit budget is bypassed, but not the minimum supply, under which the module would reset.
+ * As the tic port isn't read meanwhile, another attempt is only made if it would still end within CONFIG_ALERT_TIME_MAX_MS.
+ * @param[in] text The alert.
+ * @return true if the alert has been sent, false otherwise.
+ */
+static bool alert_send(const char *text) {
+    if (m_supply.millivolts() < CONFIG_SUPPLY_MIN_MV) {
+        return false;
+    }
+    MyMessage message(SENSOR_46_ALERT, V_TEXT);
+    message.set(text);
+    m_alert.sent = true;
+    bool success = false;
+    uint16_t overflows = m_tic_port.errors_overflow();
+    uint32_t start_ms = millis();
+    for (uint8_t i = 0; i < CONFIG_ALERT_TRIES; i++) {
+        uint32_t try_ms = millis();
+        if (message_send(message) == true) {
+            success = true;
+            break;
+        }
+        uint32_t now_ms = millis();
+        if ((now_ms - start_ms) + (now_ms - try_ms) > CONFIG_ALERT_TIME_MAX_MS) {
+            break;
+        }
+    }
+    m_diagnostics.alert_overflows += m_tic_port.errors_overflow() - overflows;
+    return success;
+}
+
+/**
+ * Raises an alert, which is sent as "<label>:<current>" if it is worse than the last one, or if that one was a while ago.
+ * @param[in] level The level of the alert, one of ALERT_LEVEL_*.
+ * @param[in] name The label of the dataset that raised it.
+ * @param[in] current The current, in A.
+ */
+static void alert_raise(uint8_t level, const char *name, uint32_t current) {
+
+    /* Remember it for the end of the frame */
+    if (level > m_alert.level_seen) {
+        m_alert.level_seen = level;
+    }
+
+    /* Don't repeat it too often */
+    if (level < m_alert.level || (level == m_alert.level && millis() - m_alert.timestamp < CONFIG_ALERT_REPEAT_S * 1000UL)) {
+        return;
+    }
+    m_alert.level = level;
+    m_alert.timestamp = millis();
+
+    /* Send it */
+    char buffer[MAX_PAYLOAD_SIZE + 1];
+    snprintf_P(buffer, sizeof(buffer), PSTR("%s:%lu"), name, (unsigned long)current);
+    if (alert_send(buffer) == false) {
+        LOG_W(MAIN, "Failed to send alert %s", buffer);
+    }
+}
+
+/**
+ * Called once all the datasets of a frame have been received.
+ * Overloads are over once a whole frame went without any, which is then sent as "-".
+ */
+static void alert_frame_end(void) {
+    if (m_alert.level != ALERT_LEVEL_NONE && m_alert.level_seen == ALERT_LEVEL_NONE) {
+        if (alert_send("-") == false) {
+            LOG_W(MAIN, "Failed to send alert end");
+        }
+    }
+    m_alert.level = m_alert.level_seen;
+    m_alert.level_seen = ALERT_LEVEL_NONE;
+}
+
+/**
+ * Called once all the datasets of a frame have been received.
+ * Checks which values need to be sent, and starts sending them in one burst.
+ */
+static void frame_end(void) {
+
+    /* Account for that frame */
+    m_diagnostics.frames++;
+    m_diagnostics.frame_timestamp = millis();
+    alert_frame_end();
+
+    /* Derive values from those received */
+    power_update(m_diagnostics.frame_timestamp);
+    if (CONFIG_AGGREGATE_WINDOW_S > 0) {
+        aggregates_update(m_diagnostics.frame_timestamp);
+    }
+
+    /* Check values received during that frame, aggregated ones are only sent as summaries */
+    uint16_t now_s = millis() / 1000;
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        if (m_channels_state[i].flags & CHANNEL_FLAG_RECEIVED) {
+            if (channel_aggregated(i) == false && channel_policy_check(i, now_s) == true) {
+                m_channels_state[i].flags |= CHANNEL_FLAG_DIRTY;
+            } else {
+                m_channels_state[i].flags &= ~CHANNEL_FLAG_DIRTY;
+            }
+            m_channels_state[i].flags &= ~CHANNEL_FLAG_RECEIVED;
+        }
+    }
+
+    /* Start sending */
+    if (m_channels_cursor >= CHANNEL_COUNT) {
+        m_channels_cursor = 0;
+    }
+}
+
+/**
+ * Handles a dataset, if it is one we're interested in, by updating the value of the channel it feeds.
+ * Values are sent later, once the frame has ended.
+ * @param[in] dataset The dataset, its data might be modified.
+ * @return The sensor fed by the dataset, or -1 if it isn't one we're interested in.
+ */
+static int8_t dataset_process(struct tic_parser_dataset &dataset) {
+
+    /* Find which channel is fed by this dataset, the parser having already looked its label up */
+    int8_t index = dataset.label;
+    if (index < 0) {
+        return -1;
+    }
+    uint8_t channel_index = pgm_read_byte(&m_labels[index].channel);
+    struct channel channel;
+    memcpy_P(&channel, &m_channels[channel_index], sizeof(struct channel));
+
+    /* The end of a frame might have been lost to line noise,
+     * but a label seen twice means a new frame has started, and so that the previous one has ended */
+    if (m_frame_labels[index / 8] & (1 << (index % 8))) {
+        memset(m_frame_labels, 0, sizeof(m_frame_labels));
+        frame_end();
+    }
+    m_frame_labels[index / 8] |= (1 << (index % 8));
+
+    /* Ignore datasets of sensors the contract doesn't use, which the controller doesn't know about */
+    if (sensor_used(channel.sensor) == false) {
+        return -1;
+    }
+
+    /* Convert data into a value that can be compared with the last one sent,
+     * free texts are compared through a hash (FNV-1a) to keep a small memory footprint */
+    char *data = dataset.data;
+    uint32_t value;
+    if (channel.kind == KIND_TEXT || channel.kind == KIND_WORD) {
+
+        /* Remove padding spaces of standard mode, and padding dots of historic mode */
+        while (*data == ' ') {
+            data++;
+        }
+        char *end = data;
+        for (char *c = data; *c != '\0' && *c != '.'; c++) {
+            if (*c != ' ') {
+                end = c + 1;
+            }
+        }
+        *end = '\0';
+
+        if (channel_index == CHANNEL_CONTRACT_NAME) {
+            contract_update(dataset.name, data);
+        }
+        if (channel.kind == KIND_TEXT) {
+            value = 2166136261UL;
+            for (char *c = data; *c != '\0'; c++) {
+                value = (value ^ (uint8_t)*c) * 16777619UL;
+            }
+        } else {
+            for (value = 0; value < WORD_COUNT && strcmp_P(data, m_words[value]) != 0; value++) {
+            }
+            if (value >= WORD_COUNT) {
+                LOG_W(TIC, "Unknown value %s for %s", data, dataset.name);
+                return channel.sensor;
+            }
+        }
+    } else {
+
+        /* Numbers have already been read by the parser, the date of horodated datasets of standard mode being skipped */
+        value = (channel.kind == KIND_HEX) ? dataset.value_hex : dataset.value;
+        if (channel.kind == KIND_U8) {
+            value = (uint8_t)value;
+        } else if (channel.kind == KIND_U16) {
+            value = (uint16_t)value;
+        }
+    }
+
+    /* Overloads reported by the meter are sent right away, as alerts rather than as values,
+     * and so are currents close to the subscribed one, as the meter only reports overloads once they happen */
+    if (channel_index == CHANNEL_OVERLOAD) {
+        alert_raise(ALERT_LEVEL_OVERLOAD, dataset.name, value);
+        return channel.sensor;
+    }
+    if (CONFIG_ALERT_CURRENT_PERCENT > 0 && (channel_index == CHANNEL_PHASE_1_CURRENT || channel_index == CHANNEL_PHASE_2_CURRENT || channel_index == CHANNEL_PHASE_3_CURRENT)) {
+        uint32_t subscribed = m_channels_state[CHANNEL_CONTRACT_CURRENT].value;
+        if (subscribed > 0 && value * 100 >= subscribed * CONFIG_ALERT_CURRENT_PERCENT) {
+            alert_raise(ALERT_LEVEL_CURRENT, dataset.name, value);
+        }
+    }
+
+    /* Remember value, it is checked against the reporting policy once the frame has ended */
+    m_channels_state[channel_index].value = value;
+    if (channel.kind == KIND_TEXT) {
+        size_t length = strlen(data);
+        if (length > TEXT_LENGTH_MAX) {
+            length = TEXT_LENGTH_MAX;
+        }
+        memcpy(m_texts[channel.text], data, length);
+        m_texts[channel.text][length] = '\0';
+    }
+    m_channels_state[channel_index].flags |= CHANNEL_FLAG_RECEIVED | CHANNEL_FLAG_KNOWN;
+
+    /* Values of high priority are checked right away rather than once the frame has ended, so that they reach the controller sooner */
+    if (channel_priority(channel_index) == PRIORITY_HIGH && channel_policy_check(channel_index, millis() / 1000) == true) {
+        m_channels_state[channel_index].flags |= CHANNEL_FLAG_DIRTY;
+        if (m_channels_cursor >= CHANNEL_COUNT) {
+            m_channels_cursor = 0;
+        }
+    }
+    return channel.sensor;
+}
+
+/**
+ * Sends one step of the diagnostics report to the controller:
+ * - V_VAR1 "<frames/s>:<datasets/s>" over the period,
+ * - V_VAR2 "<malformed datasets>:<framing errors>:<parity errors>:<overflows>" since startup,
+ * - V_VAR3 "<detections>:<seconds since last frame>:<supply in mV>:<stack unused>", detections since startup, and stack in bytes,
+ * - V_VAR4 "<sent>:<failed>" over the period,
+ * - V_VAR5 "C:<checksum errors>:<alert overflows>" since startup, the latter being characters lost while sending alerts,
+ * - V_CUSTOM "<sensor>:<sent>:<failed>" over the period, for each sensor which had messages fail,
+ * - V_VAR5 "T<task>:<max>:<overruns>" over the period, for each task which ran over its budget,
+ * - V_VAR5 for each line of profiling statistics over the period, if profiling is enabled.
+ * @param[in] step The step to send, from 0, then a sensor from DIAGNOSTICS_STEP_SENSORS, a task from DIAGNOSTICS_STEP_TASKS,
+ * then a line from DIAGNOSTICS_STEP_PROFILE.
+ * @param[in] period_s The duration of the period, in seconds.
+ * @return The next step, or -1 once the report is complete.
+ */
+#define DIAGNOSTICS_STEP_SENSORS 5
+#define DIAGNOSTICS_STEP_TASKS (DIAGNOSTICS_STEP_SENSORS + SENSOR_COUNT)
+#define DIAGNOSTICS_STEP_PROFILE (DIAGNOSTICS_STEP_TASKS + SCHEDULER_TASK_COUNT_MAX)
+static int8_t diagnostics_send(int8_t step, uint16_t period_s) {
+    uint32_t values[4];
+    uint8_t values_count;
+    uint8_t type;
+    char buffer[MAX_PAYLOAD_SIZE + 1];
+
+    /* Skip sensors without failures */
+    while (step >= DIAGNOSTICS_STEP_SENSORS && step < DIAGNOSTICS_STEP_TASKS && m_diagnostics.sensors_sends_failed[step - DIAGNOSTICS_STEP_SENSORS] == 0) {
+        step++;
+    }
+
+    /* Skip tasks which kept within their budget, the line of the first one which didn't being left in the buffer */
+    while (step >= DIAGNOSTICS_STEP_TASKS && step < DIAGNOSTICS_STEP_PROFILE && scheduler_line(buffer, sizeof(buffer), step - DIAGNOSTICS_STEP_TASKS) <= 0) {
+        step++;
+    }
+
+    /* Build message */
+    switch (step) {
+        case 0: {
+            uint8_t length = format_milli(buffer, (uint32_t)m_diagnostics.frames * 1000 / period_s);
+            buffer[length++] = ':';
+            format_milli(&buffer[length], (uint32_t)m_diagnostics.datasets * 1000 / period_s);
+            type = V_VAR1;
+            values_count = 0;
+            break;
+        }
+        case 1: {
+            values[0] = m_diagnostics.tic_errors;
+            values[1] = m_tic_port.errors_framing();
+            values[2] = m_tic_port.errors_parity();
+            values[3] = m_tic_port.errors_overflow();
+            values_count = 4;
+            type = V_VAR2;
+            break;
+        }
+        case 2: {
+            values[0] = m_diagnostics.detections;
+            values[1] = (m_diagnostics.frame_timestamp == 0) ? (millis() / 1000) : ((millis() - m_diagnostics.frame_timestamp) / 1000);
+            values[2] = m_supply.millivolts();
+            values[3] = memory_stack_unused();
+            values_count = 4;
+            type = V_VAR3;
+            break;
+        }
+        case 3: {
+            values[0] = m_diagnostics.sends_ok;
+            values[1] = m_diagnostics.sends_failed;
+            values_count = 2;
+            type = V_VAR4;
+            break;
+        }
+        case 4: {
+            buffer[0] = 'C';
+            buffer[1] = ':';
+            values[0] = m_diagnostics.tic_checksum_errors;
+            values[1] = m_diagnostics.alert_overflows;
+            format_list(&buffer[2], values, 2);
+            values_count = 0;
+            type = V_VAR5;
+            break;
+        }
+        default: {
+            if (step < DIAGNOSTICS_STEP_TASKS) {
+                values[0] = step - DIAGNOSTICS_STEP_SENSORS;
+                values[1] = m_diagnostics.sensors_sends_ok[step - DIAGNOSTICS_STEP_SENSORS];
+                values[2] = m_diagnostics.sensors_sends_failed[step - DIAGNOSTICS_STEP_SENSORS];
+                values_count = 3;
+                type = V_CUSTOM;
+                break;
+            }
+            if (step < DIAGNOSTICS_STEP_PROFILE) {
+                values_count = 0;
+                type = V_VAR5;
+                break;
+            }
+#if CONFIG_PROFILE_ENABLED
+            if (profile_line(buffer, sizeof(buffer), step - DIAGNOSTICS_STEP_PROFILE) >= 0) {
+                values_count = 0;
+                type = V_VAR5;
+                break;
+            }
+            profile_reset();
+#endif
+            scheduler_reset();
+            return -1;
+        }
+    }
+    if (values_count > 0) {
+        format_list(buffer, values, values_count);
+    }
+
+    /* Send message, a failure is accounted for but not retried, the next report will tell */
+    MyMessage message(SENSOR_42_DIAGNOSTICS, type);
+    message_send(message.set(buffer));
+    return step + 1;
+}
+
+/**
+ * Sends one part of the summary of an aggregate to the controller.
+ * Failures are not retried, as the next summary is coming.
+ * @param[in] part The part, which is the aggregate times 3, plus 0 for the mean, 1 for the minimum or 2 for the maximum.
+ */
+static void aggregate_send(uint8_t part) {
+
+    /* Retrieve aggregate and the channel it aggregates */
+    struct aggregate aggregate;
+    memcpy_P(&aggregate, &m_aggregates[part / 3], sizeof(struct aggregate));
+    struct channel channel;
+    memcpy_P(&channel, &m_channels[aggregate.channel], sizeof(struct channel));
+
+    /* Send part */
+    switch (part % 3) {
+        case 0: {
+            MyMessage message(channel.sensor, channel.type);
+            if (channel.kind == KIND_U8) {
+                char buffer[FORMAT_MILLI_LENGTH_MAX + 1];
+                format_milli(buffer, m_aggregates_summary[part / 3].mean);
+                message.set(buffer);
+            } else {
+                message.set((uint32_t)((m_aggregates_summary[part / 3].mean + 500) / 1000));
+            }
+            message_send(message);
+            break;
+        }
+        case 1: {
+            MyMessage message(channel.sensor, aggregate.type_min);
+            message_send(message.set(m_aggregates_summary[part / 3].min));
+            break;
+        }
+        case 2: {
+            MyMessage message(channel.sensor, aggregate.type_max);
+            message_send(message.set(m_aggregates_summary[part / 3].max));
+            break;
+        }
+    }
+}
+
+/**
+ * Sends the last value received on a channel to the controller.
+ * On failure, the value still needs to be sent, but is skipped for the rest of the burst, so that it is retried in the next one
+ * rather than right away.
+ * @param[in] channel_index The channel.
+ * @return true if the value has been sent, false otherwise.
+ */
+static bool channel_send(uint8_t channel_index) {
+
+    /* Retrieve channel */
+    struct channel channel;
+    memcpy_P(&channel, &m_channels[channel_index], sizeof(struct channel));
+    uint32_t value = m_channels_state[channel_index].value;
+
+    /* Send value */
+    MyMessage message(channel.sensor, channel.type);
+    switch (channel.kind) {
+        case KIND_U8: {
+            message.set((uint8_t)value);
+            break;
+        }
+        case KIND_U16: {
+            message.set((uint16_t)value);
+            break;
+        }
+        case KIND_U32: {
+            message.set(value);
+            break;
+        }
+        case KIND_KWH: {
+            char buffer[FORMAT_MILLI_LENGTH_MAX + 1];
+            format_milli(buffer, value);
+            message.set(buffer);
+            break;
+        }
+        case KIND_TEXT: {
+            message.set(m_texts[channel.text]);
+            break;
+        }
+        case KIND_HEX: {
+            char buffer[8 + 1];
+            snprintf_P(buffer, sizeof(buffer), PSTR("%08lX"), (unsigned long)value);
+            message.set(buffer);
+            break;
+        }
+        case KIND_WORD: {
+            char buffer[WORD_LENGTH_MAX + 1];
+            memcpy_P(buffer, m_words[value], sizeof(buffer));
+            message.set(buffer);
+            break;
+        }
+    }
+    if (message_send(message) == false) {
+        m_channels_state[channel_index].flags |= CHANNEL_FLAG_SKIPPED;
+        return false;
+    }
+
+    /* Remember value sent */
+    m_channels_state[channel_index].sent = value;
+    m_channels_state[channel_index].sent_s = millis() / 1000;
+    m_channels_state[channel_index].flags = (m_channels_state[channel_index].flags | CHANNEL_FLAG_REPORTED) & ~CHANNEL_FLAG_DIRTY;
+    return true;
+}
+
+/**
+ * Encodes a number as a varint, least significant bits first, 7 bits per byte, and the most significant bit set on all bytes but the last.
+ * The first byte only carries 6 bits of the number, after a flag in its least significant bit.
+ * @param[out] buffer The buffer to write into, of at least PACKED_VARINT_LENGTH_MAX bytes.
+ * @param[in] value The number.
+ * @param[in] flag The flag, 0 or 1.
+ * @return The number of bytes written.
+ */
+#define PACKED_VARINT_LENGTH_MAX 5
+static uint8_t packed_varint(uint8_t *buffer, uint32_t value, uint8_t flag) {
+    uint8_t length = 0;
+    uint8_t byte = ((value & 0x3F) << 1) | flag;
+    value >>= 6;
+    while (value != 0) {
+        buffer[length++] = byte | 0x80;
+        byte = value & 0x7F;
+        value >>= 7;
+    }
+    buffer[length++] = byte;
+    return length;
+}
+
+/**
+ * Sends several values to the controller in one message, on the packed values sensor.
+ * Items are the channels, followed by the mean, minimum and maximum of each aggregate.
+ * Those which need to be sent are taken from the given one onwards, as long as they fit, free texts excepted,
+ * and summaries of aggregates as a whole. The payload is made of:
+ * - a header byte, with the format version in the high nibble, and the length of the bitmap in the low nibble,
+ * - the first item of the bitmap, divided by 8,
+ * - a bitmap of the items present, bit n of byte n / 8 for the nth item from the first one of the bitmap,
+ * - the value of each of those items, in order, as a varint whose flag tells whether it is the value (1),
+ *   or the difference with the last value sent (0), zigzag encoded.
+ * Differences are only used for channels whose last value sent is known to have been received, and when they are shorter.
+ * On failure, values are skipped for the rest of the burst, as channel_send() does, and sent as they are in the next one,
+ * as the message might have been received anyway.
+ * Every CONFIG_PACKED_RESYNC_S, values are sent as they are the next time they need to be too, as the decoder might have missed
+ * a message past the next node, or restarted, and would otherwise never catch up.
+ * @param[in] first The first item, which must need to be sent, and not be a free text.
+ */
+#define PACKED_VERSION 1
+#define PACKED_ITEM_COUNT (CHANNEL_COUNT + AGGREGATE_COUNT * 3)
+static void packed_send(uint8_t first) {
+    uint8_t payload[MAX_PAYLOAD_SIZE];
+    uint8_t bitmap[(PACKED_ITEM_COUNT + 7) / 8] = {0};
+    uint8_t bitmap_first = first / 8;
+    uint8_t bitmap_length = 0;
+    uint8_t values[MAX_PAYLOAD_SIZE];
+    uint8_t values_length = 0;
+
+    /* Send values in full every now and then */
+    if (millis() - m_packed_resync_timestamp >= CONFIG_PACKED_RESYNC_S * 1000UL) {
+        for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+            m_channels_state[i].flags &= ~CHANNEL_FLAG_SYNCED;
+        }
+        m_packed_resync_timestamp = millis();
+    }
+
+    /* Encode values, until the payload is full */
+    for (uint8_t i = first; i < PACKED_ITEM_COUNT; i++) {
+        uint8_t encoded[PACKED_VARINT_LENGTH_MAX * 3];
+        uint8_t length;
+        uint8_t last = i;
+        if (i < CHANNEL_COUNT) {
+            if ((m_channels_state[i].flags & (CHANNEL_FLAG_DIRTY | CHANNEL_FLAG_SKIPPED)) != CHANNEL_FLAG_DIRTY || pgm_read_byte(&m_channels[i].kind) == KIND_TEXT) {
+                continue;
+            }
+            length = packed_varint(encoded, m_channels_state[i].value, 1);
+            if (m_channels_state[i].flags & CHANNEL_FLAG_SYNCED) {
+                int32_t difference = m_channels_state[i].value - m_channels_state[i].sent;
+                uint8_t encoded_difference[PACKED_VARINT_LENGTH_MAX];
+                uint8_t length_difference = packed_varint(encoded_difference, ((uint32_t)difference << 1) ^ (uint32_t)(difference >> 31), 0);
+                if (difference != 0 && length_difference <= length) {
+                    memcpy(encoded, encoded_difference, length_difference);
+                    length = length_difference;
                 }
+            }
+        } else {
+            uint8_t aggregate_index = (i - CHANNEL_COUNT) / 3;
+            if ((i - CHANNEL_COUNT) % 3 != 0 || aggregate_pending(aggregate_index) == false) {
+                continue;
+            }
+            uint32_t mean = m_aggregates_summary[aggregate_index].mean;
+            if (pgm_read_byte(&m_channels[pgm_read_byte(&m_aggregates[aggregate_index].channel)].kind) != KIND_U8) {
+                mean = (mean + 500) / 1000;
+            }
+            length = packed_varint(encoded, mean, 1);
+            length += packed_varint(&encoded[length], m_aggregates_summary[aggregate_index].min, 1);
+            length += packed_varint(&encoded[length], m_aggregates_summary[aggregate_index].max, 1);
+            last = i + 2;
+        }
+        if (2 + (last / 8 - bitmap_first + 1) + values_length + length > MAX_PAYLOAD_SIZE) {
+            break;
+        }
+        memcpy(&values[values_length], encoded, length);
+        values_length += length;
+        for (uint8_t j = i; j <= last; j++) {
+            bitmap[j / 8] |= (1 << (j % 8));
+        }
+        bitmap_length = last / 8 - bitmap_first + 1;
+    }
 
-                /* Option Tempo, index blanc HP */
-                else if (strcmp_P(dataset.name, PSTR("BBRHPJW")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_16_CONTRACT_TEMPO_INDEX_WHITE_PK, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
+    /* Assemble payload and send it */
+    payload[0] = (PACKED_VERSION << 4) | bitmap_length;
+    payload[1] = bitmap_first;
+    memcpy(&payload[2], &bitmap[bitmap_first], bitmap_length);
+    memcpy(&payload[2 + bitmap_length], values, values_length);
+    MyMessage message(SENSOR_45_PACKED, V_CUSTOM);
+    bool success = message_send(message.set(payload, 2 + bitmap_length + values_length));
+
+    /* Remember values sent, or that they might not have been received, summaries are not retried as the next one is coming */
+    uint16_t now_s = millis() / 1000;
+    for (uint8_t i = first; i < (bitmap_first + bitmap_length) * 8; i++) {
+        if ((bitmap[i / 8] & (1 << (i % 8))) == 0) {
+            continue;
+        }
+        if (i >= CHANNEL_COUNT) {
+            m_aggregates_pending &= ~(1 << ((i - CHANNEL_COUNT) / 3));
+        } else if (success == true) {
+            m_channels_state[i].sent = m_channels_state[i].value;
+            m_channels_state[i].sent_s = now_s;
+            m_channels_state[i].flags = (m_channels_state[i].flags | CHANNEL_FLAG_REPORTED | CHANNEL_FLAG_SYNCED) & ~CHANNEL_FLAG_DIRTY;
+        } else {
+            m_channels_state[i].flags = (m_channels_state[i].flags | CHANNEL_FLAG_SKIPPED) & ~CHANNEL_FLAG_SYNCED;
+        }
+    }
+}
+
+/**
+ * Led task.
+ * Blinks the green led every 10 seconds while the meter is read, the red one every second otherwise, and both while starting.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool led_task(const uint32_t now_ms) {
+    static uint32_t m_led_timestamp = 0;
+    static enum {
+        STATE_0,
+        STATE_1,
+        STATE_2,
+        STATE_3,
+        STATE_4,
+        STATE_5,
+        STATE_6,
+        STATE_7,
+        STATE_8,
+        STATE_9,
+    } m_led_sm;
+    switch (m_led_sm) {
+        case STATE_0: {
+            if (m_tic_state == STATE_STARTING) {
+                m_led_sm = STATE_1;
+            } else if (m_tic_state == STATE_VALID) {
+                m_led_sm = STATE_4;
+            } else {
+                m_led_sm = STATE_7;
+            }
+            break;
+        }
+        case STATE_1: {
+            digitalWrite(CONFIG_LED_TIC_RED_PIN, HIGH);
+            digitalWrite(CONFIG_LED_TIC_GREEN_PIN, HIGH);
+            m_led_timestamp = now_ms;
+            m_led_sm = STATE_2;
+            break;
+        }
+        case STATE_2: {
+            if (now_ms - m_led_timestamp >= 100) {
+                digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
+                digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
+                m_led_sm = STATE_3;
+            }
+            break;
+        }
+        case STATE_3: {
+            if (now_ms - m_led_timestamp >= 1000) {
+                m_led_sm = STATE_0;
+            }
+            break;
+        }
+        case STATE_4: {
+            digitalWrite(CONFIG_LED_TIC_GREEN_PIN, HIGH);
+            digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
+            m_led_timestamp = now_ms;
+            m_led_sm = STATE_5;
+            break;
+        }
+        case STATE_5: {
+            if (now_ms - m_led_timestamp >= 100) {
+                digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
+                digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
+                m_led_sm = STATE_6;
+            }
+            break;
+        }
+        case STATE_6: {
+            if (now_ms - m_led_timestamp >= 10000) {
+                m_led_sm = STATE_0;
+            }
+            break;
+        }
+        case STATE_7: {
+            digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
+            digitalWrite(CONFIG_LED_TIC_RED_PIN, HIGH);
+            m_led_timestamp = now_ms;
+            m_led_sm = STATE_8;
+            break;
+        }
+        case STATE_8: {
+            if (now_ms - m_led_timestamp >= 100) {
+                digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
+                digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
+                m_led_sm = STATE_9;
+            }
+            break;
+        }
+        case STATE_9: {
+            if (now_ms - m_led_timestamp >= 1000) {
+                m_led_sm = STATE_0;
+            }
+            break;
+        }
+    }
+    return false;
+}
+
+/**
+ * Tic reading task.
+ * Finds out the baud rate of the meter, then reads datasets and hands them over to the other tasks as they arrive.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool tic_task(const uint32_t now_ms) {
+    int res;
+    static enum {
+        STATE_0,
+        STATE_1,
+        STATE_2,
+    } m_tic_sm;
+    static uint8_t m_tic_resume_tries = 0;       // Attempts since datasets were last received
+    static bool m_tic_resume_valid = false;      // Whether a dataset has been received since the port started
+    static uint32_t m_tic_resume_timestamp = 0;  // When the port started
+    static uint8_t m_tic_checksum_errors = 0;    // Datasets in a row with a wrong checksum
+    switch (m_tic_sm) {
+
+        case STATE_0: {
+
+            /* Resume at the last baud rate that worked, as the mode of a meter hardly ever changes,
+             * it is only detected again after a few attempts without any valid dataset */
+            m_tic_port.end();
+            m_tic_resume_valid = false;
+            m_tic_resume_timestamp = now_ms;
+            m_tic_checksum_errors = 0;
+            if (m_tic_port_baudrate != 0 && m_tic_resume_tries < CONFIG_TIC_RESUME_TRIES) {
+                m_tic_resume_tries++;
+                LOG_I(TIC, "Resuming at baudrate of %u", m_tic_port_baudrate);
+                if (m_tic_port.begin(m_tic_port_baudrate) < 0) {
+                    LOG_E(TIC, "Failed to start tic port!");
+                    m_tic_state = STATE_INVALID;
+                    break;
                 }
+                m_tic_sm = STATE_2;
+                break;
+            }
 
-                /* Option Tempo, index rouge HC */
-                else if (strcmp_P(dataset.name, PSTR("BBRHCJR")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_19_CONTRACT_TEMPO_INDEX_RED_OK, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
+            /* Automatically detect baud rate at which linky meter sends the data, as it can use:
+             * - either 1200 for historic (most common),
+             * - or 9600 for standard (required when producing elecriticity) */
+            m_diagnostics.detections++;
+            if (m_tic_autobaud.start() < 0) {
+                LOG_E(TIC, "Failed to start baudrate detection!");
+                m_tic_state = STATE_INVALID;
+                break;
+            }
+            m_tic_sm = STATE_1;
+            break;
+        }
+
+        case STATE_1: {
+
+            /* Wait for baud rate detection to complete */
+            res = m_tic_autobaud.poll(m_tic_port_baudrate);
+            if (res == 0) {
+                break;
+            } else if (res < 0) {
+                LOG_E(TIC, "Failed to detect baudrate!");
+                m_tic_state = STATE_INVALID;
+                m_tic_sm = STATE_0;
+                break;
+            }
+
+            /* Start receiving at that baud rate */
+            LOG_I(TIC, "Detected baudrate of %u", m_tic_port_baudrate);
+            if (m_tic_port.begin(m_tic_port_baudrate) < 0) {
+                LOG_E(TIC, "Failed to start tic port!");
+                m_tic_state = STATE_INVALID;
+                m_tic_sm = STATE_0;
+                break;
+            }
+            m_tic_resume_timestamp = now_ms;
+            m_tic_sm = STATE_2;
+            break;
+        }
+
+        case STATE_2: {
+
+            /* Read incoming datasets, those with a wrong checksum are skipped as line noise, unless they keep coming,
+             * while malformed ones tell the link isn't read right, and restart it */
+            PROFILE_START(dispatch);
+            res = m_tic_parser.read();
+            if (res == TIC_PARSER_ERROR_CHECKSUM) {
+                m_diagnostics.tic_checksum_errors++;
+                LOG_E(TIC, "Tic checksum error! (framing %u, parity %u, overflow %u)", m_tic_port.errors_framing(), m_tic_port.errors_parity(), m_tic_port.errors_overflow());
+                if (++m_tic_checksum_errors >= CONFIG_TIC_CHECKSUM_ERRORS_MAX) {
+                    m_tic_state = STATE_INVALID;
+                    m_tic_sm = STATE_0;
+                }
+                break;
+            } else if (res < 0) {
+                m_diagnostics.tic_errors++;
+                LOG_E(TIC, "Tic error! (framing %u, parity %u, overflow %u)", m_tic_port.errors_framing(), m_tic_port.errors_parity(), m_tic_port.errors_overflow());
+                m_tic_state = STATE_INVALID;
+                m_tic_sm = STATE_0;
+                break;
+            } else if (res == 0) {
+                if (m_tic_resume_valid == false && now_ms - m_tic_resume_timestamp >= CONFIG_TIC_RESUME_TIMEOUT_MS) {
+                    LOG_W(TIC, "No dataset at baudrate of %u", m_tic_port_baudrate);
+                    m_tic_state = STATE_INVALID;
+                    m_tic_sm = STATE_0;
                 }
+                break;
+            } else if (res == TIC_PARSER_FRAME) {
 
-                /* Option Tempo, index rouge HP */
-                else if (strcmp_P(dataset.name, PSTR("BBRHPJR")) == 0) {
-                    static uint32_t value_last = 0;
-                    uint32_t value = strtoul(dataset.data, NULL, 10);
-                    if (value > value_last) {
-                        MyMessage message(SENSOR_18_CONTRACT_TEMPO_INDEX_RED_PK, V_KWH);
-                        if (send(message.set(value / 1000.0, 3)) == true) {
-                            value_last = value;
-                        }
-                    }
+                /* Check values received during that frame right away, rather than once the next one starts */
+                memset(m_frame_labels, 0, sizeof(m_frame_labels));
+                frame_end();
+                break;
+            }
+
+            struct tic_parser_dataset &dataset = m_tic_parser.dataset();
+            LOG_D(TIC, "Received dataset %s = %s", dataset.name, dataset.data);
+            m_diagnostics.datasets++;
+            m_tic_state = STATE_VALID;
+            m_tic_checksum_errors = 0;
+
+            /* A dataset with a valid checksum confirms the baud rate, which is remembered for the next startup */
+            if (m_tic_resume_valid == false) {
+                m_tic_resume_valid = true;
+                m_tic_resume_tries = 0;
+                if (tic_baudrate_load() != m_tic_port_baudrate) {
+                    tic_baudrate_save(m_tic_port_baudrate);
                 }
+            }
+
+            /* Forward it to the controller, those which raised an alert being timed apart */
+            int8_t sensor = dataset_process(dataset);
+            PROFILE_STOP(dispatch, (m_alert.sent == true) ? PROFILE_PROBE_ALERT : PROFILE_PROBE_DISPATCH, sensor);
+            m_alert.sent = false;
 
-                /* Option Tempo, couleur du lendemain */
-                else if (strcmp_P(dataset.name, PSTR("DEMAIN")) == 0) {
-                    static char value_last[4 + 1];
-                    if (strcmp(dataset.data, value_last) != 0) {
-                        MyMessage message(SENSOR_20_CONTRACT_TEMPO_TOMORROW, V_TEXT);
-                        if (send(message.set(dataset.data)) == true) {
-                            strncpy(value_last, dataset.data, 4);
-                        }
+            break;
+        }
+
+        default: {
+            m_tic_sm = STATE_0;
+            break;
+        }
+    }
+    return (m_tic_port.available() > 0);
+}
+
+/**
+ * Presentation task.
+ * Because messages might be lost, we're not doing the presentation in one block, but rather step by step,
+ * making sure each step is sucessful before advancing to the next, and retrying less and less often on failure,
+ * sensors the contract doesn't use are skipped.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool presentation_task(const uint32_t now_ms) {
+    static uint32_t m_presentation_timestamp = 0;
+    static uint16_t m_presentation_delay_ms = 0;
+    while (m_presentation_step >= 0 && m_presentation_step < SENSOR_COUNT && sensor_used(m_presentation_step) == false) {
+        m_presentation_step++;
+    }
+    if (m_presentation_step < SENSOR_COUNT && now_ms - m_presentation_timestamp >= m_presentation_delay_ms) {
+
+        /* Send out presentation information corresponding to the current step */
+        bool success;
+        if (m_presentation_step < 0) {
+            success = sendSketchInfo(F("SLHA00011 Linky"), F("1.3.0"));
+        } else {
+            uint8_t type = pgm_read_byte(&m_sensors[m_presentation_step].type);
+            success = present(m_presentation_step, type, (const __FlashStringHelper *)m_sensors[m_presentation_step].name);
+        }
+        m_presentation_timestamp = millis();
+
+        /* Advance one step if successful, and wait a little bit, otherwise the next fails
+         * @see https://forum.mysensors.org/topic/4450/sensor-presentation-failure
+         * Otherwise retry later, doubling the delay each time */
+        if (success == true) {
+            m_presentation_step++;
+            m_presentation_delay_ms = CONFIG_PRESENTATION_GAP_MS;
+        } else if (m_presentation_delay_ms < CONFIG_PRESENTATION_RETRY_MIN_MS) {
+            m_presentation_delay_ms = CONFIG_PRESENTATION_RETRY_MIN_MS;
+        } else if (m_presentation_delay_ms < CONFIG_PRESENTATION_RETRY_MAX_MS / 2) {
+            m_presentation_delay_ms *= 2;
+        } else {
+            m_presentation_delay_ms = CONFIG_PRESENTATION_RETRY_MAX_MS;
+        }
+    }
+    return false;
+}
+
+/**
+ * Supply task.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool supply_task(const uint32_t now_ms) {
+    (void)now_ms;
+    m_supply.poll();
+    return false;
+}
+
+/**
+ * Transmit task.
+ * Sends the values that need to be, one message at a time to let the other tasks run in between,
+ * once the controller knows about the sensors.
+ * Values of higher priority go first, summaries of aggregates being sent along with instantaneous values, before indexes.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool transmit_task(const uint32_t now_ms) {
+    (void)now_ms;
+    bool sent = false;
+    if (m_presentation_step >= SENSOR_COUNT && (m_channels_cursor < CHANNEL_COUNT || m_aggregates_cursor < AGGREGATE_COUNT * 3)) {
+        if (m_channels_cursor < CHANNEL_COUNT) {
+            m_channels_cursor = channel_next();
+        }
+        while (m_aggregates_cursor < AGGREGATE_COUNT * 3 && aggregate_pending(m_aggregates_cursor / 3) == false) {
+            m_aggregates_cursor++;
+        }
+        bool aggregates_first = (m_aggregates_cursor < AGGREGATE_COUNT * 3 && m_channels_cursor < CHANNEL_COUNT && channel_priority(m_channels_cursor) == PRIORITY_LOW);
+        if (m_channels_cursor < CHANNEL_COUNT && aggregates_first == false) {
+            if (tx_ready(TX_SOURCE_VALUES) == true) {
+                sent = true;
+                if (CONFIG_PACKED_ENABLED && pgm_read_byte(&m_channels[m_channels_cursor].kind) != KIND_TEXT) {
+                    packed_send(m_channels_cursor);
+                } else {
+                    channel_send(m_channels_cursor);
+                }
+            }
+        } else if (m_aggregates_cursor < AGGREGATE_COUNT * 3) {
+            if (tx_ready(TX_SOURCE_VALUES) == true) {
+                sent = true;
+                if (CONFIG_PACKED_ENABLED) {
+                    packed_send(CHANNEL_COUNT + m_aggregates_cursor);
+                } else {
+                    aggregate_send(m_aggregates_cursor);
+                    m_aggregates_cursor++;
+                    if (m_aggregates_cursor % 3 == 0) {
+                        m_aggregates_pending &= ~(1 << (m_aggregates_cursor / 3 - 1));
                     }
                 }
+            }
+        }
 
-                break;
+        /* End the burst once everything has been tried, values which failed being retried in the next one */
+        if (m_channels_cursor >= CHANNEL_COUNT && m_aggregates_cursor >= AGGREGATE_COUNT * 3) {
+            for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+                m_channels_state[i].flags &= ~CHANNEL_FLAG_SKIPPED;
             }
+            tx_done(TX_SOURCE_VALUES);
+        }
+    }
+    return sent;
+}
 
-            default: {
-                m_tic_sm = STATE_0;
-                break;
+/**
+ * Backlog task.
+ * While the gateway can't be reached, samples the energy at a fixed cadence, so that the controller can fill the gap in history afterwards.
+ * Sampling goes on until every sample has been sent, so that they stay evenly spaced, and the age of each one can be told from its position.
+ * Samples are sent back in low priority bursts, as "<age in s>:<energy in Wh>".
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool backlog_task(const uint32_t now_ms) {
+    static uint32_t m_backlog_timestamp = 0;   // When the last sample was taken
+    static uint8_t m_backlog_burst_count = 0;  // Samples sent in the current burst
+    bool sent = false;
+    if (now_ms - m_backlog_timestamp >= CONFIG_BACKLOG_PERIOD_S * 1000UL) {
+        m_backlog_timestamp = now_ms;
+        if (m_gateway_lost == true || backlog_count() > 0) {
+
+            /* Sample energy from the last value of each index, it is unknown if one of them has never been received,
+             * or if no frame has been received lately. When there is no more room, the oldest samples are given up */
+            uint32_t energy;
+            bool valid = (energy_sum(energy) != 0 && millis() - m_diagnostics.frame_timestamp < CONFIG_BACKLOG_PERIOD_S * 1000UL);
+            while (backlog_push(energy, valid) < 0 && backlog_count() > 0) {
+                backlog_pop();
+            }
+        }
+    }
+    if (m_gateway_lost == false && backlog_count() > 0 && m_presentation_step >= SENSOR_COUNT && m_channels_cursor >= CHANNEL_COUNT && m_aggregates_cursor >= AGGREGATE_COUNT * 3) {
+
+        /* Skip missing samples */
+        uint32_t value;
+        if (backlog_peek(value) == 0) {
+            backlog_pop();
+        } else if (tx_ready(TX_SOURCE_BACKLOG) == true) {
+            sent = true;
+
+            /* Send oldest sample, and only forget about it once it has been sent */
+            uint32_t values[2];
+            values[0] = (uint32_t)(backlog_count() - 1) * CONFIG_BACKLOG_PERIOD_S + (now_ms - m_backlog_timestamp) / 1000;
+            values[1] = value;
+            char buffer[2 * (FORMAT_UINT_LENGTH_MAX + 1)];
+            format_list(buffer, values, 2);
+            MyMessage message(SENSOR_44_HISTORY, V_VAR1);
+            if (message_send(message.set(buffer)) == true) {
+                backlog_pop();
             }
+            m_backlog_burst_count++;
         }
     }
+    if (m_backlog_burst_count >= CONFIG_BACKLOG_BURST_SIZE || backlog_count() == 0 || m_gateway_lost == true) {
+        m_backlog_burst_count = 0;
+        tx_done(TX_SOURCE_BACKLOG);
+    }
+    return sent;
+}
+
+/**
+ * Diagnostics task.
+ * Sends a report periodically, one message at a time, in a low priority burst.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool diagnostics_task(const uint32_t now_ms) {
+    static uint32_t m_diagnostics_timestamp = 0;
+    static int8_t m_diagnostics_step = -1;
+    bool sent = false;
+    if (m_diagnostics_step < 0 && now_ms - m_diagnostics_timestamp >= CONFIG_DIAGNOSTICS_PERIOD_S * 1000UL) {
+        m_diagnostics_step = 0;
+    }
+    if (m_diagnostics_step >= 0 && m_presentation_step >= SENSOR_COUNT && m_channels_cursor >= CHANNEL_COUNT && m_aggregates_cursor >= AGGREGATE_COUNT * 3 && tx_ready(TX_SOURCE_DIAGNOSTICS) == true) {
+        uint16_t period_s = (now_ms - m_diagnostics_timestamp) / 1000;
+        m_diagnostics_step = diagnostics_send(m_diagnostics_step, (period_s > 0) ? period_s : 1);
+        sent = true;
+        if (m_diagnostics_step < 0) {
+            tx_done(TX_SOURCE_DIAGNOSTICS);
+            m_diagnostics.frames = 0;
+            m_diagnostics.datasets = 0;
+            m_diagnostics.sends_ok = 0;
+            m_diagnostics.sends_failed = 0;
+            memset(m_diagnostics.sensors_sends_ok, 0, sizeof(m_diagnostics.sensors_sends_ok));
+            memset(m_diagnostics.sensors_sends_failed, 0, sizeof(m_diagnostics.sensors_sends_failed));
+            m_diagnostics_timestamp = millis();
+        }
+    }
+    return sent;
+}
+
+#if CONFIG_PROFILE_ENABLED
+/**
+ * Profile task.
+ * Outputs profiling statistics when 'p' is received on the serial port.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool profile_task(const uint32_t now_ms) {
+    (void)now_ms;
+    if (Serial.available() > 0 && Serial.read() == 'p') {
+        profile_dump(Serial);
+    }
+    return false;
+}
+#endif
+
+/**
+ * Log task.
+ * Outputs logs only when no tic data is waiting, and only as much as fits without blocking.
+ * @param[in] now_ms The time of the tick.
+ * @return true if the task has more to do right away, false otherwise.
+ */
+static bool log_task(const uint32_t now_ms) {
+    (void)now_ms;
+    if (m_tic_port.available() == 0) {
+        log_flush(Serial);
+    }
+    return false;
+}
+
+/* Tasks, run in that order by the scheduler
+ * Budgets of tasks which send messages allow for one message, the tic task being allowed to send an alert */
+static const struct scheduler_task m_tasks[] PROGMEM = {
+    {led_task, 10, 100, 'L'},
+    {tic_task, 0, 5000, 'T'},
+    {presentation_task, 10, 10000, 'P'},
+    {supply_task, 1, 200, 'S'},
+    {transmit_task, 0, 10000, 'X'},
+    {backlog_task, 0, 10000, 'B'},
+    {diagnostics_task, 0, 10000, 'D'},
+#if CONFIG_PROFILE_ENABLED
+    {profile_task, 100, UINT16_MAX, 'R'},
+#endif
+    {log_task, 0, 1000, 'O'},
+};
+#define TASK_COUNT (sizeof(m_tasks) / sizeof(m_tasks[0]))
+
+/**
+ * Tells whether characters have been received since the tasks last ran, in which case the cpu shouldn't sleep.
+ * Called by the scheduler with interrupts disabled.
+ * @return true if there are characters to read, false otherwise.
+ */
+static bool tasks_pending(void) {
+    return (m_tic_port.available() > 0 || Serial.available() > 0);
+}
+
+/**
+ * Setup function.
+ * Called before MySensors does anything.
+ */
+void preHwInit(void) {
+
+    /* Setup leds
+     * Ensures tic link led is off at startup */
+    pinMode(CONFIG_LED_TIC_GREEN_PIN, OUTPUT);
+    pinMode(CONFIG_LED_TIC_RED_PIN, OUTPUT);
+    digitalWrite(CONFIG_LED_TIC_GREEN_PIN, LOW);
+    digitalWrite(CONFIG_LED_TIC_RED_PIN, LOW);
+}
+
+/**
+ * Setup function.
+ * Called once MySensors has successfully initialized.
+ */
+void setup(void) {
+
+    /* Setup serial port to computer */
+    Serial.begin(115200);
+    LOG_I(MAIN, "Hello world.");
+
+    /* Load settings */
+    if (settings_load() < 0) {
+        LOG_W(MAIN, "Invalid settings, using defaults.");
+        settings_default();
+    }
+    log_level_set(m_settings.log_level);
+
+    /* Load contract learned before, if any */
+    m_contract = loadState(CONFIG_EEPROM_CONTRACT_ADDRESS);
+    if (m_contract >= CONTRACT_COUNT) {
+        m_contract = CONTRACT_UNKNOWN;
+    }
+    LOG_I(MAIN, "Contract %u.", m_contract);
+
+    /* Setup tic reader, starting at the last baud rate that worked, if any */
+    m_tic_port_baudrate = tic_baudrate_load();
+    m_tic_autobaud.setup(CONFIG_TIC_DATA_PIN);
+    m_tic_port.setup(CONFIG_TIC_DATA_PIN);
+    m_tic_parser.setup(m_tic_port, m_labels, sizeof(struct label), LABEL_COUNT);
+
+    /* Setup supply monitoring */
+    m_supply.setup();
+
+    /* Setup tasks */
+    scheduler_setup(m_tasks, TASK_COUNT, tasks_pending);
+
+    /* Return */
+    LOG_I(MAIN, "Setup done, ram: %u bytes static, %u bytes free.", memory_static(), memory_free());
+}
+
+/**
+ * Main loop.
+ * Tasks are run by the scheduler, between which MySensors does its own processing.
+ */
+void loop(void) {
+    PROFILE_LOOP();
+    scheduler_tick();
 }
@@ -0,0 +1,64 @@
+/* Self header */
+#include "memory.h"
+
+/* AVR libraries */
+#include <avr/io.h>
+
+/* Value ram is painted with at startup, stack usage is then told by how much of it has been overwritten */
+#define MEMORY_PAINT 0xA5
+
+/* Symbols of the linker script and of the C library */
+extern uint8_t __data_start;
+extern uint8_t _end;
+extern uint8_t __stack;
+extern char *__brkval;
+
+/**
+ * Paints the ram between the end of static variables and the top of the stack.
+ * It runs from the .init1 section, before anything else, so it can't rely on the C runtime: no stack, and r1 not cleared yet.
+ */
+void memory_paint(void) __attribute__((naked, used, section(".init1")));
+void memory_paint(void) {
+    __asm volatile(
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, %0\n"
+        "    ldi r25, hi8(__stack)\n"
+        "    rjmp 2f\n"
+        "1:\n"
+        "    st Z+, r24\n"
+        "2:\n"
+        "    cpi r30, lo8(__stack)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n" ::"i"(MEMORY_PAINT));
+}
+
+/**
+ * @return The ram taken by static variables, in bytes.
+ */
+uint16_t memory_static(void) {
+    return &_end - &__data_start;
+}
+
+/**
+ * @return The ram currently left between the heap and the stack, in bytes.
+ */
+uint16_t memory_free(void) {
+    uint8_t *heap_end = (__brkval == 0) ? &_end : (uint8_t *)__brkval;
+    return (uint8_t *)SP - heap_end;
+}
+
+/**
+ * Tells how close the stack has come to the heap since startup.
+ * Painted bytes are counted from the end of the heap, up to the first one the stack has overwritten.
+ * @return The ram the stack has never used, in bytes.
+ */
+uint16_t memory_stack_unused(void) {
+    uint8_t *heap_end = (__brkval == 0) ? &_end : (uint8_t *)__brkval;
+    uint16_t count = 0;
+    for (uint8_t *p = heap_end; p < (uint8_t *)SP && *p == MEMORY_PAINT; p++) {
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,11 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+uint16_t memory_static(void);
+uint16_t memory_free(void);
+uint16_t memory_stack_unused(void);
+
+#endif
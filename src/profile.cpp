@@ -0,0 +1,196 @@
+/* Self header */
+#include "profile.h"
+
+/* Project code */
+#include "format.h"
+
+/* Everything compiles to nothing when profiling is disabled */
+#if CONFIG_PROFILE_ENABLED
+
+/* Ensure sampling allows cheap modulo */
+#if (CONFIG_PROFILE_LOOP_SAMPLING & (CONFIG_PROFILE_LOOP_SAMPLING - 1)) != 0 || CONFIG_PROFILE_LOOP_SAMPLING > 256
+#error "CONFIG_PROFILE_LOOP_SAMPLING must be a power of two no greater than 256"
+#endif
+
+/* Working variables */
+static uint32_t m_loop_count = 0;
+static uint32_t m_loop_start_us = 0;   // When the statistics were last reset
+static uint32_t m_loop_sample_us = 0;  // When the loop being sampled started
+static bool m_loop_sampling = false;   // Whether the current loop is being sampled
+static uint32_t m_loop_max_us = 0;     // Longest loop among those sampled
+static uint32_t m_loop_idle_us = 0;    // Time spent asleep since the statistics were last reset
+static struct {
+    uint32_t max_us;
+    uint8_t max_id;
+    uint16_t buckets[PROFILE_BUCKET_COUNT];  // Saturate at 65535
+} m_probes[PROFILE_PROBE_COUNT];
+static const char m_probes_letters[PROFILE_PROBE_COUNT + 1] PROGMEM = "DSA";
+
+/**
+ * Accounts for one iteration of the main loop, to be called at its very beginning.
+ * The mean loop time is derived from the number of iterations, which is cheap to count,
+ * but timing every iteration would cost more than the 1 % budget, so only one in CONFIG_PROFILE_LOOP_SAMPLING is timed for the maximum.
+ * Long iterations are mostly caused by the sections timed with probes, which are timed every time.
+ */
+void profile_loop(void) {
+    m_loop_count++;
+    if (m_loop_sampling == true) {
+        uint32_t duration_us = micros() - m_loop_sample_us;
+        if (duration_us > m_loop_max_us) {
+            m_loop_max_us = duration_us;
+        }
+        m_loop_sampling = false;
+    } else if (((uint8_t)m_loop_count & (CONFIG_PROFILE_LOOP_SAMPLING - 1)) == 0) {
+        m_loop_sample_us = micros();
+        m_loop_sampling = true;
+    }
+}
+
+/**
+ * Accounts for the execution of a section timed by a probe.
+ * @param[in] probe The probe, one of PROFILE_PROBE_*.
+ * @param[in] duration_us How long the section took, in us.
+ * @param[in] id What the section worked on (such as a sensor), remembered for the longest execution.
+ */
+void profile_record(const uint8_t probe, const uint32_t duration_us, const uint8_t id) {
+
+    /* Keep track of the longest */
+    if (duration_us > m_probes[probe].max_us) {
+        m_probes[probe].max_us = duration_us;
+        m_probes[probe].max_id = id;
+    }
+
+    /* Find bucket, which is the position of the most significant bit */
+    uint8_t bucket = 0;
+    uint32_t value = duration_us;
+    if (value >= (1UL << PROFILE_BUCKET_COUNT)) {
+        bucket = PROFILE_BUCKET_COUNT - 1;
+    } else {
+        if (value >= 256) {
+            value >>= 8;
+            bucket = 8;
+        }
+        while (value > 1) {
+            value >>= 1;
+            bucket++;
+        }
+    }
+    if (m_probes[probe].buckets[bucket] < UINT16_MAX) {
+        m_probes[probe].buckets[bucket]++;
+    }
+}
+
+/**
+ * Accounts for time the cpu spent asleep, waiting for something to do, which is left out of the loop time.
+ * The loop being sampled, if any, has its start moved forward by as much.
+ * @param[in] duration_us How long the cpu slept, in us.
+ */
+void profile_idle(const uint32_t duration_us) {
+    m_loop_idle_us += duration_us;
+    m_loop_sample_us += duration_us;
+}
+
+/**
+ * Appends a number to a line, if it fits.
+ * @param[in,out] buffer The line.
+ * @param[in] length The length of the line.
+ * @param[in] size The size of the buffer.
+ * @param[in] separator The character to write before the number, or '\0' for none.
+ * @param[in] value The number.
+ * @return The new length of the line, which is unchanged if the number doesn't fit.
+ */
+static uint8_t profile_line_append(char *buffer, uint8_t length, const uint8_t size, const char separator, const uint32_t value) {
+    char digits[FORMAT_UINT_LENGTH_MAX + 1];
+    uint8_t digits_length = format_uint(digits, value);
+    uint8_t needed = digits_length + ((separator != '\0') ? 1 : 0);
+    if (length + needed + 1 > size) {
+        buffer[length] = '\0';
+        return length;
+    }
+    if (separator != '\0') {
+        buffer[length++] = separator;
+    }
+    memcpy(&buffer[length], digits, digits_length + 1);
+    return length + digits_length;
+}
+
+/**
+ * Formats the statistics as a few short lines, small enough to fit in a message payload:
+ * - "L:<mean>:<max>" for the loop time, in us, sleep excluded,
+ * - "<probe>:<max>:<id>" for the longest execution of each probe, in us, and what it worked on,
+ * - "<probe>H<first>:<count>:<count>..." for the histogram of each probe, starting at the first non empty bucket, and truncated if it doesn't fit.
+ * Probes are identified by a letter, D for dispatch, S for send, and A for dispatch which raised an alert.
+ * @param[out] buffer The buffer to write into.
+ * @param[in] size The size of the buffer, numbers that don't fit are left out.
+ * @param[in] line The line to format, from 0.
+ * @return The length of the line, or -1 if there is no such line.
+ */
+int8_t profile_line(char *buffer, const uint8_t size, const uint8_t line) {
+    uint8_t length = 0;
+
+    /* Loop time */
+    if (line == 0) {
+        uint32_t mean_us = (m_loop_count > 0) ? (micros() - m_loop_start_us - m_loop_idle_us) / m_loop_count : 0;
+        buffer[length++] = 'L';
+        length = profile_line_append(buffer, length, size, ':', mean_us);
+        length = profile_line_append(buffer, length, size, ':', m_loop_max_us);
+        return length;
+    }
+
+    /* Longest execution, then histogram, of each probe */
+    uint8_t probe = (line - 1) / 2;
+    if (probe >= PROFILE_PROBE_COUNT) {
+        return -1;
+    }
+    buffer[length++] = pgm_read_byte(&m_probes_letters[probe]);
+    if ((line - 1) % 2 == 0) {
+        length = profile_line_append(buffer, length, size, ':', m_probes[probe].max_us);
+        length = profile_line_append(buffer, length, size, ':', m_probes[probe].max_id);
+    } else {
+        uint8_t first = 0;
+        uint8_t last = PROFILE_BUCKET_COUNT - 1;
+        while (first < last && m_probes[probe].buckets[first] == 0) {
+            first++;
+        }
+        while (last > first && m_probes[probe].buckets[last] == 0) {
+            last--;
+        }
+        buffer[length++] = 'H';
+        length = profile_line_append(buffer, length, size, '\0', first);
+        for (uint8_t i = first; i <= last; i++) {
+            uint8_t res = profile_line_append(buffer, length, size, ':', m_probes[probe].buckets[i]);
+            if (res == length) {
+                break;
+            }
+            length = res;
+        }
+    }
+    return length;
+}
+
+/**
+ * Outputs all the statistics, one line at a time.
+ * This blocks until everything is output, so it is meant to be used on request only.
+ * @param[in] output Where to output statistics.
+ */
+void profile_dump(Print &output) {
+    char buffer[CONFIG_LOG_LINE_LENGTH_MAX + 1];
+    for (uint8_t i = 0; profile_line(buffer, sizeof(buffer), i) >= 0; i++) {
+        output.print(F(" [p] "));
+        output.println(buffer);
+    }
+}
+
+/**
+ * Clears the statistics, to start a new measurement period.
+ */
+void profile_reset(void) {
+    m_loop_count = 0;
+    m_loop_start_us = micros();
+    m_loop_sampling = false;
+    m_loop_max_us = 0;
+    m_loop_idle_us = 0;
+    memset(m_probes, 0, sizeof(m_probes));
+}
+
+#endif
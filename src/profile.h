@@ -0,0 +1,43 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/* Config */
+#include "../cfg/config.h"
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/* Code sections being timed */
+enum profile_probe {
+    PROFILE_PROBE_DISPATCH,  // Reading and processing of a dataset
+    PROFILE_PROBE_SEND,      // Sending of a message
+    PROFILE_PROBE_ALERT,     // Reading and processing of a dataset which raised an alert, up to the alert being sent
+    PROFILE_PROBE_COUNT,
+};
+
+/* Number of buckets of latency histograms, bucket n counts durations from 2^n to 2^(n+1) - 1 us,
+ * the first one also counts durations under 1 us, and the last one those over */
+#define PROFILE_BUCKET_COUNT 16
+
+/* Profiling macros
+ * They compile to nothing unless CONFIG_PROFILE_ENABLED is set */
+#if CONFIG_PROFILE_ENABLED
+#define PROFILE_LOOP() profile_loop()
+#define PROFILE_START(name) uint32_t profile_##name##_start = micros()
+#define PROFILE_STOP(name, probe, id) profile_record((probe), micros() - profile_##name##_start, (id))
+#define PROFILE_IDLE(name) profile_idle(micros() - profile_##name##_start)
+#else
+#define PROFILE_LOOP()
+#define PROFILE_START(name)
+#define PROFILE_STOP(name, probe, id) ((void)(id))
+#define PROFILE_IDLE(name)
+#endif
+
+void profile_loop(void);
+void profile_record(const uint8_t probe, const uint32_t duration_us, const uint8_t id);
+void profile_idle(const uint32_t duration_us);
+int8_t profile_line(char *buffer, const uint8_t size, const uint8_t line);
+void profile_dump(Print &output);
+void profile_reset(void);
+
+#endif
@@ -0,0 +1,136 @@
+/* Self header */
+#include "scheduler.h"
+
+/* Project code */
+#include "format.h"
+#include "profile.h"
+
+/* AVR libraries */
+#include <avr/sleep.h>
+
+/* C/C++ libraries */
+#include <errno.h>
+
+/* Working variables */
+static const struct scheduler_task *m_tasks = NULL;  // In program memory
+static uint8_t m_tasks_count = 0;
+static bool (*m_pending)(void) = NULL;
+static struct {
+    uint16_t timestamp_ms;  // When the task last ran, wraps around after a minute, which is more than any period
+    uint16_t time_max_us;   // Longest run, saturates at 65535
+    uint16_t overruns;      // Runs longer than the budget, saturates at 65535
+    bool busy;              // Whether the task has more to do right away
+} m_slots[SCHEDULER_TASK_COUNT_MAX];
+
+/**
+ * Registers the tasks, which are then run in the order of the list.
+ * @param[in] tasks The list of tasks, in program memory.
+ * @param[in] count The number of tasks, at most SCHEDULER_TASK_COUNT_MAX.
+ * @param[in] pending A function telling whether interrupts brought something for the tasks to handle since they last ran,
+ * called with interrupts disabled right before sleeping, or NULL if there is nothing to check.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int scheduler_setup(const struct scheduler_task *tasks, const uint8_t count, bool (*pending)(void)) {
+
+    /* Ensure tasks fit in slots */
+    if (tasks == NULL || count > SCHEDULER_TASK_COUNT_MAX) {
+        return -EINVAL;
+    }
+
+    /* Save tasks, which all run at the first tick */
+    m_tasks = tasks;
+    m_tasks_count = count;
+    m_pending = pending;
+    for (uint8_t i = 0; i < count; i++) {
+        m_slots[i].busy = true;
+    }
+    scheduler_reset();
+
+    /* Return success */
+    return 0;
+}
+
+/**
+ * Runs the tasks which are due, to be called from the main loop.
+ * A task is due once its period has elapsed since it last ran, or right away if it said it had more to do.
+ * Once no task has anything left to do, the cpu sleeps until the next interrupt, which is at most the next millis() tick,
+ * or the next character from the meter, the serial port or the radio. Interrupts are disabled while checking nothing came in
+ * since the tasks ran, and only enabled again right before sleeping, so that none can slip in between and be left waiting.
+ * Time spent asleep is left out of the loop time profiled.
+ */
+void scheduler_tick(void) {
+    uint32_t now_ms = millis();
+    bool busy = false;
+    for (uint8_t i = 0; i < m_tasks_count; i++) {
+
+        /* Skip tasks which aren't due */
+        uint16_t period_ms = pgm_read_word(&m_tasks[i].period_ms);
+        if (m_slots[i].busy == false && (uint16_t)((uint16_t)now_ms - m_slots[i].timestamp_ms) < period_ms) {
+            continue;
+        }
+
+        /* Run task */
+        bool (*function)(const uint32_t now_ms) = (bool (*)(const uint32_t))pgm_read_ptr(&m_tasks[i].function);
+        m_slots[i].timestamp_ms = now_ms;
+        uint32_t start_us = micros();
+        m_slots[i].busy = function(now_ms);
+        uint32_t duration_us = micros() - start_us;
+        busy |= m_slots[i].busy;
+
+        /* Account for the time it took */
+        if (duration_us > m_slots[i].time_max_us) {
+            m_slots[i].time_max_us = (duration_us < UINT16_MAX) ? duration_us : UINT16_MAX;
+        }
+        if (duration_us > pgm_read_word(&m_tasks[i].budget_us) && m_slots[i].overruns < UINT16_MAX) {
+            m_slots[i].overruns++;
+        }
+    }
+
+    /* Sleep until something happens, the instruction after enabling interrupts always running before any of them */
+    if (CONFIG_SCHEDULER_SLEEP_ENABLED && busy == false) {
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        noInterrupts();
+        if (m_pending == NULL || m_pending() == false) {
+            PROFILE_START(sleep);
+            sleep_enable();
+            interrupts();
+            sleep_cpu();
+            sleep_disable();
+            PROFILE_IDLE(sleep);
+        }
+        interrupts();
+    }
+}
+
+/**
+ * Formats the statistics of a task as "T<task>:<max>:<overruns>", with its longest run in us, and how many runs were over budget.
+ * Tasks are identified by their letter.
+ * @param[out] buffer The buffer to write into.
+ * @param[in] size The size of the buffer, at least SCHEDULER_LINE_LENGTH_MAX + 1.
+ * @param[in] line The task, from 0.
+ * @return The length of the line, 0 if the task had no run over budget, and so nothing worth reporting, or -1 if there is no such task.
+ */
+int8_t scheduler_line(char *buffer, const uint8_t size, const uint8_t line) {
+    if (line >= m_tasks_count || size < SCHEDULER_LINE_LENGTH_MAX + 1) {
+        return -1;
+    }
+    if (m_slots[line].overruns == 0) {
+        buffer[0] = '\0';
+        return 0;
+    }
+    uint32_t values[2] = {m_slots[line].time_max_us, m_slots[line].overruns};
+    buffer[0] = 'T';
+    buffer[1] = pgm_read_byte(&m_tasks[line].letter);
+    buffer[2] = ':';
+    return 3 + format_list(&buffer[3], values, 2);
+}
+
+/**
+ * Clears the statistics, to start a new measurement period.
+ */
+void scheduler_reset(void) {
+    for (uint8_t i = 0; i < m_tasks_count; i++) {
+        m_slots[i].time_max_us = 0;
+        m_slots[i].overruns = 0;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/* Config */
+#include "../cfg/config.h"
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/* Number of task slots */
+#define SCHEDULER_TASK_COUNT_MAX 10
+
+/* Longest statistics line, without the terminating null character */
+#define SCHEDULER_LINE_LENGTH_MAX (3 + 2 * 6)
+
+/**
+ * A task, as listed in program memory.
+ * Each run should do one short step of work and return, so that the other tasks and MySensors get to run in between.
+ */
+struct scheduler_task {
+    bool (*function)(const uint32_t now_ms);  // Runs one step, given the time of the tick, returns true if there is more to do right away
+    uint16_t period_ms;                       // Time between two runs while it has nothing to do, 0 to run at every tick
+    uint16_t budget_us;                       // Time a run should take at most, longer ones are counted as overruns
+    char letter;                              // Identifies the task in statistics
+};
+
+int scheduler_setup(const struct scheduler_task *tasks, const uint8_t count, bool (*pending)(void));
+void scheduler_tick(void);
+int8_t scheduler_line(char *buffer, const uint8_t size, const uint8_t line);
+void scheduler_reset(void);
+
+#endif
@@ -0,0 +1,73 @@
+/* Self header */
+#include "supply_monitor.h"
+
+/* Config */
+#include "../cfg/config.h"
+
+/* Arduino Libraries */
+#include <avr/io.h>
+
+/**
+ * Configures the adc to measure the bandgap reference against the supply.
+ * The adc must not be used for anything else afterwards.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int supply_monitor::setup(void) {
+
+    /* Select supply as reference, and bandgap as input,
+     * the bandgap then needs a little time to settle before conversions are accurate */
+    ADMUX = (1 << REFS0) | (1 << MUX3) | (1 << MUX2) | (1 << MUX1);
+    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    m_settle_ms = millis();
+    m_state = STATE_SETTLING;
+    m_millivolts = 0;
+
+    /* Return success */
+    return 0;
+}
+
+/**
+ * Makes progress on the measurement, to be called as often as possible.
+ * A conversion takes about 100 us, and is restarted as soon as the previous one is done.
+ */
+void supply_monitor::poll(void) {
+    switch (m_state) {
+
+        case STATE_SETTLING: {
+            if (millis() - m_settle_ms < 2) {
+                break;
+            }
+            ADCSRA |= (1 << ADSC);
+            m_state = STATE_CONVERTING;
+            break;
+        }
+
+        case STATE_CONVERTING: {
+            if (ADCSRA & (1 << ADSC)) {
+                break;
+            }
+
+            /* Convert reading, and smooth it a little, as the radio causes short dips */
+            uint16_t reading = ADC;
+            if (reading > 0) {
+                uint16_t millivolts = ((uint32_t)CONFIG_SUPPLY_BANDGAP_MV * 1024) / reading;
+                if (m_millivolts == 0) {
+                    m_millivolts = millivolts;
+                } else {
+                    m_millivolts = (3 * (uint32_t)m_millivolts + millivolts) / 4;
+                }
+            }
+
+            /* Start next conversion */
+            ADCSRA |= (1 << ADSC);
+            break;
+        }
+    }
+}
+
+/**
+ * @return The supply voltage in mV, or 0 until a first measurement has been made.
+ */
+uint16_t supply_monitor::millivolts(void) {
+    return m_millivolts;
+}
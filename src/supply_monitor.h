@@ -0,0 +1,27 @@
+#ifndef SUPPLY_MONITOR_H
+#define SUPPLY_MONITOR_H
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/**
+ * Measures the supply voltage without blocking.
+ * The internal bandgap reference is converted by the adc against the supply,
+ * so the lower the supply, the higher the reading.
+ */
+class supply_monitor {
+   public:
+    int setup(void);
+    void poll(void);
+    uint16_t millivolts(void);
+
+   protected:
+    enum {
+        STATE_SETTLING,
+        STATE_CONVERTING,
+    } m_state;
+    uint32_t m_settle_ms;
+    uint16_t m_millivolts;
+};
+
+#endif
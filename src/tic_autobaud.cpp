@@ -0,0 +1,128 @@
+/* Self header */
+#include "tic_autobaud.h"
+
+/* Config */
+#include "../cfg/config.h"
+
+/* C/C++ libraries */
+#include <errno.h>
+
+/* Working variables, shared with the interrupt handler */
+uint8_t tic_autobaud::m_pin = 0xFF;
+volatile uint32_t tic_autobaud::m_fall_us = 0;
+volatile uint32_t tic_autobaud::m_width_us_min = UINT32_MAX;
+volatile uint8_t tic_autobaud::m_samples = 0;
+
+/**
+ * Configures the detector.
+ * @param[in] pin The data pin, which must support external interrupts.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int tic_autobaud::setup(const uint8_t pin) {
+
+    /* Ensure pin supports external interrupts */
+    if (digitalPinToInterrupt(pin) == NOT_AN_INTERRUPT) {
+        return -EINVAL;
+    }
+
+    /* Save pin */
+    m_pin = pin;
+    m_running = false;
+
+    /* Return success */
+    return 0;
+}
+
+/**
+ * Starts a new detection.
+ * The result is then retrieved by calling poll() until it no longer returns 0.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int tic_autobaud::start(void) {
+
+    /* Ensure setup has been done */
+    if (m_pin == 0xFF) {
+        return -EINVAL;
+    }
+
+    /* Reset measurements */
+    noInterrupts();
+    m_fall_us = 0;
+    m_width_us_min = UINT32_MAX;
+    m_samples = 0;
+    interrupts();
+
+    /* Start capturing edges */
+    pinMode(m_pin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(m_pin), isr, CHANGE);
+    m_start_ms = millis();
+    m_running = true;
+
+    /* Return success */
+    return 0;
+}
+
+/**
+ * Checks on the progress of the detection.
+ * @param[out] baudrate The detected baud rate, either 1200 or 9600.
+ * @return 1 if the baud rate has been detected, 0 if the detection is still in progress,
+ * -ETIMEDOUT if not enough edges were seen in time, or -EIO if the pulses do not match a known baud rate.
+ */
+int tic_autobaud::poll(uint16_t &baudrate) {
+
+    /* Ensure detection is running */
+    if (m_running == false) {
+        return -EINVAL;
+    }
+
+    /* Wait for enough samples, or give up if the line stays silent */
+    if (m_samples < CONFIG_TIC_AUTOBAUD_SAMPLES) {
+        if (millis() - m_start_ms >= CONFIG_TIC_AUTOBAUD_TIMEOUT_MS) {
+            stop();
+            return -ETIMEDOUT;
+        }
+        return 0;
+    }
+    stop();
+
+    /* Convert minimal period to frequency */
+    noInterrupts();
+    uint32_t width_us_min = m_width_us_min;
+    interrupts();
+    if (width_us_min >= 666 && width_us_min <= 1000) {
+        baudrate = 1200;
+        return 1;
+    } else if (width_us_min >= 83 && width_us_min <= 125) {
+        baudrate = 9600;
+        return 1;
+    } else {
+        return -EIO;
+    }
+}
+
+/**
+ * Stops capturing edges.
+ */
+void tic_autobaud::stop(void) {
+    if (m_running == true) {
+        detachInterrupt(digitalPinToInterrupt(m_pin));
+        m_running = false;
+    }
+}
+
+/**
+ * Interrupt handler called on each edge of the data pin.
+ * Measures the duration the pin stays low, which is a multiple of the bit duration.
+ */
+void tic_autobaud::isr(void) {
+    uint32_t now_us = micros();
+    if (digitalRead(m_pin) == LOW) {
+        m_fall_us = now_us;
+    } else if (m_fall_us != 0 && m_samples < CONFIG_TIC_AUTOBAUD_SAMPLES) {
+        uint32_t width_us = now_us - m_fall_us;
+        if (width_us < m_width_us_min) {
+            m_width_us_min = width_us;
+        }
+        m_samples++;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef TIC_AUTOBAUD_H
+#define TIC_AUTOBAUD_H
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/**
+ * Detects the baud rate of the tic link without blocking.
+ * Falling and rising edges of the data pin are timestamped from an external interrupt,
+ * and the shortest low pulse seen over a window of samples gives the duration of one bit.
+ */
+class tic_autobaud {
+   public:
+    int setup(const uint8_t pin);
+    int start(void);
+    int poll(uint16_t &baudrate);
+    void stop(void);
+
+   protected:
+    static void isr(void);
+    static uint8_t m_pin;
+    static volatile uint32_t m_fall_us;
+    static volatile uint32_t m_width_us_min;
+    static volatile uint8_t m_samples;
+    uint32_t m_start_ms;
+    bool m_running;
+};
+
+#endif
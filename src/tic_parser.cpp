@@ -0,0 +1,229 @@
+/* Self header */
+#include "tic_parser.h"
+
+/* C/C++ libraries */
+#include <errno.h>
+
+/* Control characters of the tic link */
+#define TIC_PARSER_STX 0x02  // Start of frame
+#define TIC_PARSER_ETX 0x03  // End of frame
+#define TIC_PARSER_EOT 0x04  // Frame interrupted
+#define TIC_PARSER_HT 0x09   // Separator of standard mode
+#define TIC_PARSER_LF 0x0A   // Start of dataset
+#define TIC_PARSER_CR 0x0D   // End of dataset
+#define TIC_PARSER_SP 0x20   // Separator of historic mode
+
+/* Numbers accumulated from a field */
+#define TIC_PARSER_NUMBER_DECIMAL (1 << 0)
+#define TIC_PARSER_NUMBER_HEX (1 << 1)
+#define TIC_PARSER_NUMBER_STARTED (1 << 2)
+
+/**
+ * Configures the parser.
+ * @param[in] stream The stream the tic link is received from.
+ * @param[in] labels The table of labels to look up, in program memory, each entry starting with the label as a null terminated string,
+ * of at most TIC_PARSER_NAME_LENGTH_MAX characters. It must be sorted in strcmp order.
+ * @param[in] label_size The size of an entry of the table, in bytes.
+ * @param[in] label_count The number of entries of the table.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int tic_parser::setup(Stream &stream, const void *labels, const uint8_t label_size, const uint8_t label_count) {
+
+    /* Ensure labels can be looked up */
+    if (labels == NULL || label_size <= TIC_PARSER_NAME_LENGTH_MAX || label_count == 0 || label_count > INT8_MAX) {
+        return -EINVAL;
+    }
+
+    /* Save parameters */
+    m_stream = &stream;
+    m_labels = (const uint8_t *)labels;
+    m_label_size = label_size;
+    m_label_count = label_count;
+    m_state = STATE_IDLE;
+
+    /* Return success */
+    return 0;
+}
+
+/**
+ * Handles a character of a dataset, but its checksum.
+ * The label is looked up by narrowing the range of labels of the table which start with the characters received so far,
+ * which being sorted have the next character in order, from both ends. This walks the table as a trie would, each label at most once.
+ * @param[in] character The character.
+ */
+void tic_parser::character_process(const uint8_t character) {
+    m_sum += character;
+
+    switch (m_state) {
+
+        case STATE_LABEL: {
+
+            /* The first separator ends the label, and tells the mode */
+            if (character == TIC_PARSER_SP || character == TIC_PARSER_HT) {
+                m_separator = character;
+                m_dataset.name[(m_name_length < TIC_PARSER_NAME_LENGTH_MAX) ? m_name_length : TIC_PARSER_NAME_LENGTH_MAX] = '\0';
+                m_dataset.label = -1;
+                if (m_name_length <= TIC_PARSER_NAME_LENGTH_MAX && m_label_low < m_label_end && pgm_read_byte(&m_labels[m_label_low * m_label_size + m_name_length]) == '\0') {
+                    m_dataset.label = m_label_low;
+                }
+                m_data_length = 0;
+                m_value = 0;
+                m_value_hex = 0;
+                m_numbers = (m_dataset.label >= 0) ? (TIC_PARSER_NUMBER_DECIMAL | TIC_PARSER_NUMBER_HEX) : 0;
+                m_state = STATE_DATA;
+                break;
+            }
+
+            /* Narrow labels that could still match */
+            if (m_name_length < TIC_PARSER_NAME_LENGTH_MAX) {
+                m_dataset.name[m_name_length] = character;
+                while (m_label_low < m_label_end && pgm_read_byte(&m_labels[m_label_low * m_label_size + m_name_length]) < character) {
+                    m_label_low++;
+                }
+                while (m_label_low < m_label_end && pgm_read_byte(&m_labels[(m_label_end - 1) * m_label_size + m_name_length]) > character) {
+                    m_label_end--;
+                }
+            } else {
+                m_label_end = m_label_low;
+            }
+            if (m_name_length < UINT8_MAX) {
+                m_name_length++;
+            }
+            break;
+        }
+
+        case STATE_DATA: {
+
+            /* A separator ends a field, the last one being the value */
+            if (character == m_separator) {
+                m_dataset.data[(m_data_length < TIC_PARSER_DATA_LENGTH_MAX) ? m_data_length : TIC_PARSER_DATA_LENGTH_MAX] = '\0';
+                m_dataset.value = m_value;
+                m_dataset.value_hex = m_value_hex;
+                m_fields++;
+                m_data_length = 0;
+                m_value = 0;
+                m_value_hex = 0;
+                m_numbers = (m_dataset.label >= 0) ? (TIC_PARSER_NUMBER_DECIMAL | TIC_PARSER_NUMBER_HEX) : 0;
+                break;
+            }
+
+            /* Keep text */
+            if (m_data_length < TIC_PARSER_DATA_LENGTH_MAX) {
+                m_dataset.data[m_data_length] = character;
+            }
+            if (m_data_length < UINT8_MAX) {
+                m_data_length++;
+            }
+
+            /* Accumulate numbers as strtoul() would, skipping leading spaces and stopping at the first character which isn't a digit,
+             * datasets which aren't in the table being left as text */
+            if (m_numbers == 0 || (character == ' ' && !(m_numbers & TIC_PARSER_NUMBER_STARTED))) {
+                break;
+            }
+            m_numbers |= TIC_PARSER_NUMBER_STARTED;
+            if (m_numbers & TIC_PARSER_NUMBER_DECIMAL) {
+                if (character >= '0' && character <= '9') {
+                    m_value = (m_value * 10) + (character - '0');
+                } else {
+                    m_numbers &= ~TIC_PARSER_NUMBER_DECIMAL;
+                }
+            }
+            if (m_numbers & TIC_PARSER_NUMBER_HEX) {
+                if (character >= '0' && character <= '9') {
+                    m_value_hex = (m_value_hex << 4) | (character - '0');
+                } else if (character >= 'A' && character <= 'F') {
+                    m_value_hex = (m_value_hex << 4) | (character - 'A' + 10);
+                } else if (character >= 'a' && character <= 'f') {
+                    m_value_hex = (m_value_hex << 4) | (character - 'a' + 10);
+                } else {
+                    m_numbers &= ~TIC_PARSER_NUMBER_HEX;
+                }
+            }
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+/**
+ * Reads what has been received from the link, until a dataset or a frame is complete.
+ * Each character is handled once the next one has been received, so that the checksum, which is the last one of a dataset,
+ * is never taken for data, even when it happens to be the separator.
+ * @return TIC_PARSER_DATASET when a dataset has been received, which dataset() then gives until the next call,
+ * TIC_PARSER_FRAME when a frame has ended, 0 if more characters are needed, TIC_PARSER_ERROR_CHECKSUM if a dataset has a wrong checksum,
+ * or a negative error code otherwise.
+ */
+int tic_parser::read(void) {
+    while (m_stream->available() > 0) {
+        uint8_t character = m_stream->read();
+        switch (character) {
+
+            case TIC_PARSER_LF: {
+                m_state = STATE_LABEL;
+                m_label_low = 0;
+                m_label_end = m_label_count;
+                m_name_length = 0;
+                m_fields = 0;
+                m_sum = 0;
+                m_last_valid = false;
+                break;
+            }
+
+            case TIC_PARSER_CR: {
+                if (m_state == STATE_IDLE) {
+                    break;
+                }
+                m_state = STATE_IDLE;
+
+                /* Ensure a separator comes right before the checksum */
+                if (m_last_valid == false || m_fields == 0 || m_data_length != 0) {
+                    return -EIO;
+                }
+
+                /* Ensure checksum is valid, the separator before it is only summed in standard mode */
+                uint8_t sum = m_sum;
+                if (m_separator == TIC_PARSER_SP) {
+                    sum -= TIC_PARSER_SP;
+                }
+                if (((sum & 0x3F) + 0x20) != m_last) {
+                    return TIC_PARSER_ERROR_CHECKSUM;
+                }
+                return TIC_PARSER_DATASET;
+            }
+
+            case TIC_PARSER_STX:
+            case TIC_PARSER_EOT: {
+                m_state = STATE_IDLE;
+                break;
+            }
+
+            case TIC_PARSER_ETX: {
+                m_state = STATE_IDLE;
+                return TIC_PARSER_FRAME;
+            }
+
+            default: {
+                if (m_state == STATE_IDLE) {
+                    break;
+                }
+                if (m_last_valid == true) {
+                    character_process(m_last);
+                }
+                m_last = character;
+                m_last_valid = true;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @return The last dataset received, its data might be modified.
+ */
+struct tic_parser_dataset &tic_parser::dataset(void) {
+    return m_dataset;
+}
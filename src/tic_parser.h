@@ -0,0 +1,68 @@
+#ifndef TIC_PARSER_H
+#define TIC_PARSER_H
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/* Longest label and data kept, longer ones are truncated */
+#define TIC_PARSER_NAME_LENGTH_MAX 8
+#define TIC_PARSER_DATA_LENGTH_MAX 20
+
+/* What read() returns, besides 0 and negative error codes */
+#define TIC_PARSER_DATASET 1
+#define TIC_PARSER_FRAME 2
+
+/* Error read() returns for a dataset whose checksum doesn't match, so that line noise can be told apart from malformed datasets
+ * It is out of the range of errno values, most of which share the same number in avr-libc */
+#define TIC_PARSER_ERROR_CHECKSUM INT16_MIN
+
+/**
+ * A dataset, as parsed from the link.
+ * Horodated datasets of standard mode have their date skipped, only the value is kept.
+ */
+struct tic_parser_dataset {
+    int8_t label;                               // Index of the label in the table given to setup(), or -1 if it isn't in it
+    char name[TIC_PARSER_NAME_LENGTH_MAX + 1];  // Label
+    char data[TIC_PARSER_DATA_LENGTH_MAX + 1];  // Value, as text
+    uint32_t value;                             // Value, as a decimal number, up to its first character that isn't a digit
+    uint32_t value_hex;                         // Value, as an hexadecimal number, up to its first character that isn't a digit
+};
+
+/**
+ * Parses the tic link one character at a time, as they arrive, in both historic and standard modes.
+ * The checksum is summed up, the label is looked up and numbers are accumulated along the way,
+ * so that a dataset is complete as soon as its last character has been received.
+ */
+class tic_parser {
+   public:
+    int setup(Stream &stream, const void *labels, const uint8_t label_size, const uint8_t label_count);
+    int read(void);
+    struct tic_parser_dataset &dataset(void);
+
+   protected:
+    void character_process(const uint8_t character);
+    Stream *m_stream;
+    const uint8_t *m_labels;
+    uint8_t m_label_size;
+    uint8_t m_label_count;
+    enum {
+        STATE_IDLE,   // Waiting for the start of a dataset
+        STATE_LABEL,  // Receiving the label
+        STATE_DATA,   // Receiving the date and value, separated by the separator
+    } m_state;
+    uint8_t m_label_low;    // First label of the table which could still match
+    uint8_t m_label_end;    // Label of the table after the last one which could still match
+    uint8_t m_name_length;  // Characters received for the label
+    uint8_t m_data_length;  // Characters received for the current field
+    uint8_t m_fields;       // Fields of data received
+    uint8_t m_separator;    // Separator of the dataset, space in historic mode, tab in standard mode
+    uint8_t m_sum;          // Sum of the characters received, but the last one
+    uint8_t m_last;         // Last character received, which might be the checksum
+    bool m_last_valid;      // Whether a character has been received since the start of the dataset
+    uint8_t m_numbers;      // Numbers of the current field still being accumulated, as TIC_PARSER_NUMBER_* flags
+    uint32_t m_value;       // Current field, as a decimal number
+    uint32_t m_value_hex;   // Current field, as an hexadecimal number
+    struct tic_parser_dataset m_dataset;
+};
+
+#endif
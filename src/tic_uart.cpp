@@ -0,0 +1,263 @@
+/* Self header */
+#include "tic_uart.h"
+
+/* AVR libraries */
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+/* C/C++ libraries */
+#include <errno.h>
+
+/* Ensure buffer size allows cheap index wrapping */
+#if (CONFIG_TIC_UART_BUFFER_SIZE & (CONFIG_TIC_UART_BUFFER_SIZE - 1)) != 0 || CONFIG_TIC_UART_BUFFER_SIZE > 128
+#error "CONFIG_TIC_UART_BUFFER_SIZE must be a power of two no greater than 128"
+#endif
+
+/* Number of bits in a character: start, 7 data, parity and stop */
+#define TIC_UART_FRAME_BITS 10
+
+/* Working variables, shared with the interrupt handlers */
+uint8_t tic_uart::m_pin = 0xFF;
+volatile uint8_t *tic_uart::m_pin_register;
+uint8_t tic_uart::m_pin_mask;
+uint16_t tic_uart::m_bit_ticks;
+volatile bool tic_uart::m_receiving = false;
+volatile uint16_t tic_uart::m_sample;
+volatile uint16_t tic_uart::m_bits;
+volatile uint8_t tic_uart::m_bits_count;
+volatile uint8_t tic_uart::m_level;
+volatile uint8_t tic_uart::m_buffer[CONFIG_TIC_UART_BUFFER_SIZE];
+volatile uint8_t tic_uart::m_buffer_head = 0;
+volatile uint8_t tic_uart::m_buffer_tail = 0;
+volatile uint16_t tic_uart::m_errors_framing = 0;
+volatile uint16_t tic_uart::m_errors_parity = 0;
+volatile uint16_t tic_uart::m_errors_overflow = 0;
+
+/**
+ * Configures the uart.
+ * @param[in] pin The data pin, which must support external interrupts.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int tic_uart::setup(const uint8_t pin) {
+
+    /* Ensure pin supports external interrupts */
+    if (digitalPinToInterrupt(pin) == NOT_AN_INTERRUPT) {
+        return -EINVAL;
+    }
+
+    /* Save pin, and how to read it quickly from interrupt handlers */
+    m_pin = pin;
+    m_pin_register = portInputRegister(digitalPinToPort(pin));
+    m_pin_mask = digitalPinToBitMask(pin);
+
+    /* Return success */
+    return 0;
+}
+
+/**
+ * Starts receiving.
+ * This takes over Timer1, which runs freely with a prescaler of 8.
+ * @param[in] baudrate The baud rate of the link.
+ * @return 0 in case of success, or a negative error code otherwise.
+ */
+int tic_uart::begin(const uint16_t baudrate) {
+
+    /* Ensure setup has been done */
+    if (m_pin == 0xFF || baudrate == 0) {
+        return -EINVAL;
+    }
+
+    /* Compute bit duration in timer ticks
+     * The whole character must fit in half a timer period, as timestamps are compared as signed differences */
+    uint32_t bit_ticks = ((F_CPU / 8) + (baudrate / 2)) / baudrate;
+    if (bit_ticks * TIC_UART_FRAME_BITS > INT16_MAX) {
+        return -EINVAL;
+    }
+
+    /* Reset state */
+    end();
+    m_bit_ticks = bit_ticks;
+    m_receiving = false;
+    m_buffer_head = 0;
+    m_buffer_tail = 0;
+
+    /* Start timer in normal mode */
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11);
+    TIMSK1 = 0;
+
+    /* Start capturing edges */
+    pinMode(m_pin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(m_pin), isr_edge, CHANGE);
+
+    /* Return success */
+    return 0;
+}
+
+/**
+ * Stops receiving, and releases Timer1.
+ */
+void tic_uart::end(void) {
+    if (m_pin != 0xFF) {
+        detachInterrupt(digitalPinToInterrupt(m_pin));
+    }
+    TIMSK1 = 0;
+    TCCR1B = 0;
+    m_receiving = false;
+}
+
+/**
+ * @return The number of characters waiting to be read.
+ */
+int tic_uart::available(void) {
+    return (uint8_t)(m_buffer_head - m_buffer_tail) & (CONFIG_TIC_UART_BUFFER_SIZE - 1);
+}
+
+/**
+ * @return The next character received, or -1 if there is none.
+ */
+int tic_uart::read(void) {
+    if (m_buffer_head == m_buffer_tail) {
+        return -1;
+    }
+    uint8_t data = m_buffer[m_buffer_tail];
+    m_buffer_tail = (m_buffer_tail + 1) & (CONFIG_TIC_UART_BUFFER_SIZE - 1);
+    return data;
+}
+
+/**
+ * @return The next character received without removing it, or -1 if there is none.
+ */
+int tic_uart::peek(void) {
+    if (m_buffer_head == m_buffer_tail) {
+        return -1;
+    }
+    return m_buffer[m_buffer_tail];
+}
+
+/**
+ * The tic link is receive only, characters written are dropped.
+ */
+size_t tic_uart::write(uint8_t data) {
+    (void)data;
+    return 0;
+}
+
+/**
+ * @return The number of characters dropped because of an invalid stop bit.
+ */
+uint16_t tic_uart::errors_framing(void) {
+    noInterrupts();
+    uint16_t errors = m_errors_framing;
+    interrupts();
+    return errors;
+}
+
+/**
+ * @return The number of characters dropped because of an invalid parity bit.
+ */
+uint16_t tic_uart::errors_parity(void) {
+    noInterrupts();
+    uint16_t errors = m_errors_parity;
+    interrupts();
+    return errors;
+}
+
+/**
+ * @return The number of characters dropped because the buffer was full.
+ */
+uint16_t tic_uart::errors_overflow(void) {
+    noInterrupts();
+    uint16_t errors = m_errors_overflow;
+    interrupts();
+    return errors;
+}
+
+/**
+ * Interrupt handler called on each edge of the data pin.
+ * Bits whose middle lies before the edge all had the level the line had before that edge.
+ */
+void tic_uart::isr_edge(void) {
+    uint16_t now = TCNT1;
+    uint8_t level = (*m_pin_register & m_pin_mask) ? 1 : 0;
+
+    /* Record the bits that elapsed since the previous edge */
+    if (m_receiving == true) {
+        while (m_bits_count < TIC_UART_FRAME_BITS && (int16_t)(now - m_sample) > 0) {
+            m_bits |= (uint16_t)m_level << m_bits_count;
+            m_bits_count++;
+            m_sample += m_bit_ticks;
+        }
+        if (m_bits_count >= TIC_UART_FRAME_BITS) {
+            frame_end();
+        } else {
+            m_level = level;
+        }
+    }
+
+    /* A falling edge while idle is a start bit
+     * The character is completed by the compare match in the middle of its stop bit, in case no edge follows */
+    if (m_receiving == false && level == 0) {
+        m_receiving = true;
+        m_level = 0;
+        m_bits = 0;
+        m_bits_count = 0;
+        m_sample = now + (m_bit_ticks / 2);
+        OCR1A = m_sample + (TIC_UART_FRAME_BITS - 1) * m_bit_ticks;
+        TIFR1 = _BV(OCF1A);
+        TIMSK1 |= _BV(OCIE1A);
+    }
+}
+
+/**
+ * Completes the character being received, and pushes it into the buffer if it is valid.
+ * Bits not recorded yet have the current level of the line.
+ */
+void tic_uart::frame_end(void) {
+
+    /* Record remaining bits and stop waiting for the compare match */
+    while (m_bits_count < TIC_UART_FRAME_BITS) {
+        m_bits |= (uint16_t)m_level << m_bits_count;
+        m_bits_count++;
+    }
+    TIMSK1 &= ~_BV(OCIE1A);
+    m_receiving = false;
+
+    /* Ensure stop bit is high */
+    if ((m_bits & (1 << (TIC_UART_FRAME_BITS - 1))) == 0) {
+        m_errors_framing++;
+        return;
+    }
+
+    /* Ensure parity is even, over data and parity bits */
+    uint8_t data = (m_bits >> 1) & 0x7F;
+    uint8_t parity = (m_bits >> 8) & 1;
+    for (uint8_t i = data; i != 0; i >>= 1) {
+        parity ^= i & 1;
+    }
+    if (parity != 0) {
+        m_errors_parity++;
+        return;
+    }
+
+    /* Push into buffer */
+    uint8_t head_next = (m_buffer_head + 1) & (CONFIG_TIC_UART_BUFFER_SIZE - 1);
+    if (head_next == m_buffer_tail) {
+        m_errors_overflow++;
+        return;
+    }
+    m_buffer[m_buffer_head] = data;
+    m_buffer_head = head_next;
+}
+
+/**
+ * Interrupt handler called in the middle of the stop bit of the character being received.
+ */
+void tic_uart_isr_compare(void) {
+    if (tic_uart::m_receiving == true) {
+        tic_uart::frame_end();
+    }
+}
+ISR(TIMER1_COMPA_vect) {
+    tic_uart_isr_compare();
+}
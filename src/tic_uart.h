@@ -0,0 +1,51 @@
+#ifndef TIC_UART_H
+#define TIC_UART_H
+
+/* Config */
+#include "../cfg/config.h"
+
+/* Arduino Libraries */
+#include <Arduino.h>
+
+/**
+ * Receive only uart for the tic link, in 7 bits even parity 1 stop bit format.
+ * Bits are decoded from timestamps of the data pin edges, taken from Timer1 in an external interrupt,
+ * and a Timer1 compare match completes each character after its stop bit.
+ * Unlike SoftwareSerial, interrupts stay enabled for the whole character, apart from a short handler on each edge.
+ */
+class tic_uart : public Stream {
+   public:
+    int setup(const uint8_t pin);
+    int begin(const uint16_t baudrate);
+    void end(void);
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t data);
+    using Print::write;
+    uint16_t errors_framing(void);
+    uint16_t errors_parity(void);
+    uint16_t errors_overflow(void);
+
+   protected:
+    static void isr_edge(void);
+    static void frame_end(void);
+    friend void tic_uart_isr_compare(void);
+    static uint8_t m_pin;
+    static volatile uint8_t *m_pin_register;
+    static uint8_t m_pin_mask;
+    static uint16_t m_bit_ticks;
+    static volatile bool m_receiving;
+    static volatile uint16_t m_sample;
+    static volatile uint16_t m_bits;
+    static volatile uint8_t m_bits_count;
+    static volatile uint8_t m_level;
+    static volatile uint8_t m_buffer[CONFIG_TIC_UART_BUFFER_SIZE];
+    static volatile uint8_t m_buffer_head;
+    static volatile uint8_t m_buffer_tail;
+    static volatile uint16_t m_errors_framing;
+    static volatile uint16_t m_errors_parity;
+    static volatile uint16_t m_errors_overflow;
+};
+
+#endif
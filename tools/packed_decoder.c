@@ -0,0 +1,294 @@
+/* Reference decoder of packed values, for the gateway side
+ *
+ * Reads the MySensors serial protocol ("node;sensor;command;ack;type;payload" lines) on its standard input,
+ * as output by a serial gateway, and writes it back on its standard output,
+ * with packed values messages replaced by one message per value, as if the module had sent them one by one.
+ * It can then be put between a serial gateway and a controller, for instance with socat.
+ *
+ * Build: cc -O2 -o packed_decoder tools/packed_decoder.c
+ * Usage: packed_decoder < /dev/ttyUSB0 */
+
+/* C/C++ libraries */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Packed values messages, see the README for the format */
+#define PACKED_SENSOR 45
+#define PACKED_TYPE 48  // V_CUSTOM
+#define PACKED_VERSION 1
+#define PAYLOAD_SIZE_MAX 25
+
+/* Variable types */
+#define V_VAR1 24
+#define V_VAR2 25
+#define V_VAR3 26
+#define V_VAR4 27
+#define V_WATT 17
+#define V_KWH 18
+#define V_TEXT 47
+#define V_VOLTAGE 38
+#define V_CURRENT 39
+
+/* Kinds of values, as in the firmware */
+enum {
+    KIND_U8,
+    KIND_U16,
+    KIND_U32,
+    KIND_KWH,
+    KIND_TEXT,
+    KIND_HEX,
+    KIND_WORD,
+};
+
+/* List of channels, which must be kept in the same order as in the firmware (m_channels in src/main.cpp) */
+struct channel {
+    uint8_t sensor;
+    uint8_t type;
+    uint8_t kind;
+};
+static const struct channel m_channels[] = {
+    {0, V_TEXT, KIND_TEXT},      // CHANNEL_SERIAL_NUMBER
+    {1, V_CURRENT, KIND_U8},     // CHANNEL_PHASE_1_CURRENT
+    {1, V_VOLTAGE, KIND_U16},    // CHANNEL_PHASE_1_VOLTAGE
+    {2, V_CURRENT, KIND_U8},     // CHANNEL_PHASE_2_CURRENT
+    {2, V_VOLTAGE, KIND_U16},    // CHANNEL_PHASE_2_VOLTAGE
+    {3, V_CURRENT, KIND_U8},     // CHANNEL_PHASE_3_CURRENT
+    {3, V_VOLTAGE, KIND_U16},    // CHANNEL_PHASE_3_VOLTAGE
+    {4, V_WATT, KIND_U32},       // CHANNEL_POWER_APPARENT
+    {5, V_TEXT, KIND_TEXT},      // CHANNEL_CONTRACT_NAME
+    {6, V_CURRENT, KIND_U8},     // CHANNEL_CONTRACT_CURRENT
+    {7, V_TEXT, KIND_TEXT},      // CHANNEL_CONTRACT_PERIOD
+    {8, V_KWH, KIND_KWH},        // CHANNEL_CONTRACT_BASE_INDEX
+    {9, V_KWH, KIND_KWH},        // CHANNEL_CONTRACT_HC_INDEX_HC
+    {10, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_HC_INDEX_HP
+    {11, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_EJP_INDEX_HN
+    {12, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_EJP_INDEX_HPM
+    {13, V_TEXT, KIND_U8},       // CHANNEL_CONTRACT_EJP_NOTICE
+    {14, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_PK
+    {15, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_TEMPO_INDEX_BLUE_OK
+    {16, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_PK
+    {17, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_TEMPO_INDEX_WHITE_OK
+    {18, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_TEMPO_INDEX_RED_PK
+    {19, V_KWH, KIND_KWH},       // CHANNEL_CONTRACT_TEMPO_INDEX_RED_OK
+    {20, V_TEXT, KIND_WORD},     // CHANNEL_CONTRACT_TEMPO_TOMORROW
+    {21, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_TOTAL
+    {22, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_01
+    {23, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_02
+    {24, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_03
+    {25, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_04
+    {26, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_05
+    {27, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_06
+    {28, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_07
+    {29, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_08
+    {30, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_09
+    {31, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_DELIVERED_INDEX_10
+    {32, V_KWH, KIND_KWH},       // CHANNEL_ENERGY_INJECTED_TOTAL
+    {33, V_WATT, KIND_U32},      // CHANNEL_POWER_APPARENT_PHASE_1
+    {34, V_WATT, KIND_U32},      // CHANNEL_POWER_APPARENT_PHASE_2
+    {35, V_WATT, KIND_U32},      // CHANNEL_POWER_APPARENT_PHASE_3
+    {36, V_WATT, KIND_U32},      // CHANNEL_POWER_APPARENT_INJECTED
+    {37, V_WATT, KIND_U32},      // CHANNEL_POWER_APPARENT_MAX_PHASE_1
+    {38, V_WATT, KIND_U32},      // CHANNEL_POWER_APPARENT_MAX_PHASE_2
+    {39, V_WATT, KIND_U32},      // CHANNEL_POWER_APPARENT_MAX_PHASE_3
+    {40, V_TEXT, KIND_HEX},      // CHANNEL_STATUS
+    {43, V_WATT, KIND_U32},      // CHANNEL_POWER_ACTIVE
+    {46, V_TEXT, KIND_U16},      // CHANNEL_OVERLOAD
+};
+#define CHANNEL_COUNT (sizeof(m_channels) / sizeof(m_channels[0]))
+
+/* List of aggregates, which must be kept in the same order as in the firmware (m_aggregates in src/main.cpp)
+ * Their mean, minimum and maximum follow the channels, they are always sent as they are */
+struct aggregate {
+    uint8_t channel;
+    uint8_t type_min;
+    uint8_t type_max;
+};
+static const struct aggregate m_aggregates[] = {
+    {1, V_VAR1, V_VAR2},   // AGGREGATE_PHASE_1_CURRENT
+    {2, V_VAR3, V_VAR4},   // AGGREGATE_PHASE_1_VOLTAGE
+    {3, V_VAR1, V_VAR2},   // AGGREGATE_PHASE_2_CURRENT
+    {4, V_VAR3, V_VAR4},   // AGGREGATE_PHASE_2_VOLTAGE
+    {5, V_VAR1, V_VAR2},   // AGGREGATE_PHASE_3_CURRENT
+    {6, V_VAR3, V_VAR4},   // AGGREGATE_PHASE_3_VOLTAGE
+    {7, V_VAR1, V_VAR2},   // AGGREGATE_POWER_APPARENT
+    {36, V_VAR1, V_VAR2},  // AGGREGATE_POWER_APPARENT_PHASE_1
+    {37, V_VAR1, V_VAR2},  // AGGREGATE_POWER_APPARENT_PHASE_2
+    {38, V_VAR1, V_VAR2},  // AGGREGATE_POWER_APPARENT_PHASE_3
+    {39, V_VAR1, V_VAR2},  // AGGREGATE_POWER_APPARENT_INJECTED
+};
+#define AGGREGATE_COUNT (sizeof(m_aggregates) / sizeof(m_aggregates[0]))
+#define ITEM_COUNT (CHANNEL_COUNT + AGGREGATE_COUNT * 3)
+
+/* List of words, as in the firmware (m_words in src/main.cpp) */
+static const char *const m_words[] = {"----", "BLEU", "BLAN", "ROUG"};
+#define WORD_COUNT (sizeof(m_words) / sizeof(m_words[0]))
+
+/* Last value received on each channel of each node, differences apply to them */
+static struct {
+    uint32_t value;
+    uint8_t known;
+} m_values[256][CHANNEL_COUNT];
+
+/**
+ * Decodes a varint, whose first byte carries a flag in its least significant bit.
+ * @param[in] buffer The buffer to read from.
+ * @param[in] length The number of bytes left in the buffer.
+ * @param[out] value The number.
+ * @param[out] flag The flag.
+ * @return The number of bytes read, or -1 if the varint is truncated or too long.
+ */
+static int varint_decode(const uint8_t *buffer, size_t length, uint32_t *value, uint8_t *flag) {
+    if (length == 0) {
+        return -1;
+    }
+    *flag = buffer[0] & 1;
+    *value = (buffer[0] >> 1) & 0x3F;
+    uint8_t shift = 6;
+    size_t i = 0;
+    while (buffer[i] & 0x80) {
+        i++;
+        if (i >= length || shift > 27) {
+            return -1;
+        }
+        *value |= (uint32_t)(buffer[i] & 0x7F) << shift;
+        shift += 7;
+    }
+    return i + 1;
+}
+
+/**
+ * Prints a value as a message of the MySensors serial protocol.
+ * @param[in] node The node that sent it.
+ * @param[in] item The channel, or the part of the aggregate, it belongs to.
+ * @param[in] value The value.
+ */
+static void value_print(unsigned int node, size_t item, uint32_t value) {
+
+    /* Summaries of aggregates are sent on the sensor of the channel, with their own types, and a mean in thousandths for currents */
+    const struct channel *channel = &m_channels[(item < CHANNEL_COUNT) ? item : m_aggregates[(item - CHANNEL_COUNT) / 3].channel];
+    uint8_t type = channel->type;
+    uint8_t kind = channel->kind;
+    if (item >= CHANNEL_COUNT) {
+        const struct aggregate *aggregate = &m_aggregates[(item - CHANNEL_COUNT) / 3];
+        switch ((item - CHANNEL_COUNT) % 3) {
+            case 0: {
+                kind = (kind == KIND_U8) ? KIND_KWH : KIND_U32;
+                break;
+            }
+            case 1: {
+                type = aggregate->type_min;
+                kind = KIND_U32;
+                break;
+            }
+            case 2: {
+                type = aggregate->type_max;
+                kind = KIND_U32;
+                break;
+            }
+        }
+    }
+
+    printf("%u;%u;1;0;%u;", node, channel->sensor, type);
+    switch (kind) {
+        case KIND_KWH: {
+            printf("%lu.%03lu\n", (unsigned long)value / 1000, (unsigned long)value % 1000);
+            break;
+        }
+        case KIND_HEX: {
+            printf("%08lX\n", (unsigned long)value);
+            break;
+        }
+        case KIND_WORD: {
+            printf("%s\n", (value < WORD_COUNT) ? m_words[value] : "?");
+            break;
+        }
+        default: {
+            printf("%lu\n", (unsigned long)value);
+            break;
+        }
+    }
+}
+
+/**
+ * Decodes a packed values message, and prints each value it holds.
+ * @param[in] node The node that sent it.
+ * @param[in] payload The payload.
+ * @param[in] length The length of the payload.
+ * @return 0 in case of success, or -1 if the payload is invalid.
+ */
+static int packed_decode(unsigned int node, const uint8_t *payload, size_t length) {
+
+    /* Parse header */
+    if (length < 2 || (payload[0] >> 4) != PACKED_VERSION) {
+        return -1;
+    }
+    size_t bitmap_length = payload[0] & 0x0F;
+    size_t bitmap_first = payload[1] * 8;
+    if (2 + bitmap_length > length) {
+        return -1;
+    }
+    const uint8_t *bitmap = &payload[2];
+    size_t position = 2 + bitmap_length;
+
+    /* Decode values of the items present */
+    for (size_t bit = 0; bit < bitmap_length * 8; bit++) {
+        if ((bitmap[bit / 8] & (1 << (bit % 8))) == 0) {
+            continue;
+        }
+        size_t i = bitmap_first + bit;
+        uint32_t value;
+        uint8_t absolute;
+        int res = varint_decode(&payload[position], length - position, &value, &absolute);
+        if (res < 0 || i >= ITEM_COUNT || (i >= CHANNEL_COUNT && absolute == 0)) {
+            return -1;
+        }
+        position += res;
+        if (i >= CHANNEL_COUNT) {
+            value_print(node, i, value);
+            continue;
+        }
+        if (absolute == 0) {
+            if (m_values[node][i].known == 0) {
+                fprintf(stderr, "Node %u channel %zu: difference without a previous value, skipped\n", node, i);
+                continue;
+            }
+            value = m_values[node][i].value + ((value >> 1) ^ -(value & 1));
+        }
+        m_values[node][i].value = value;
+        m_values[node][i].known = 1;
+        value_print(node, i, value);
+    }
+    return (position == length) ? 0 : -1;
+}
+
+int main(void) {
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+
+        /* Forward anything but packed values messages as is */
+        unsigned int node, sensor, command, ack, type;
+        int offset = 0;
+        if (sscanf(line, "%u;%u;%u;%u;%u;%n", &node, &sensor, &command, &ack, &type, &offset) != 5 || offset == 0 ||
+            node > 255 || sensor != PACKED_SENSOR || command != 1 || type != PACKED_TYPE) {
+            fputs(line, stdout);
+            fflush(stdout);
+            continue;
+        }
+
+        /* Payloads of V_CUSTOM messages are printed in hexadecimal by the gateway */
+        uint8_t payload[PAYLOAD_SIZE_MAX];
+        size_t length = 0;
+        const char *hex = &line[offset];
+        while (length < sizeof(payload) && sscanf(hex, "%2hhx", &payload[length]) == 1) {
+            length++;
+            hex += 2;
+        }
+        if (packed_decode(node, payload, length) < 0) {
+            fprintf(stderr, "Node %u: invalid packed values message: %s", node, line);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}